@@ -22,6 +22,7 @@ ivec3 NORMALS[6] = ivec3[](
   vec3( 0, -1, 0)
 );
 
+const float CHUNK_SIZE = 62.0;
 const float AO_MIN = 0.3;
 const float AO_PART = (1.0 - AO_MIN) / 3.0;
 
@@ -34,6 +35,8 @@ void main()
     float x = float(data.x&uint(63));
     float y = float((data.x >> 6)&uint(63));
     float z = float((data.x >> 12)&uint(63));
+    // Chunks meshed as one stack share its model matrix and are offset by their index in the stack
+    z += float((data.x >> 20)&uint(3)) * CHUNK_SIZE;
     uint ao = uint((data.x >> 18)&uint(3));
 
     uint fragNormalIndex = uint((data.y >> 20)&uint(7));
@@ -43,7 +46,7 @@ void main()
     AOMultiplier = calculateAOMultiplier(ao);
     TexCoords = vec3(
 		float(data.y&uint(63)),
-		float((data.y >> 6)&uint(63)),
+		float(((data.y >> 6)&uint(63)) | ((data.y >> 18)&uint(192))),
 		float((data.y >> 12)&uint(255))
 	);
 
@@ -0,0 +1,130 @@
+#shader vertex
+
+#version 330 core
+
+// One greedy quad per instance
+layout (location = 0) in uvec2 quad;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out float AOMultiplier;
+out vec3 TexCoords;
+flat out ivec3 FragNormal;
+out float isGrass;
+
+ivec3 NORMALS[6] = ivec3[](
+  vec3( 0, 0, -1 ),
+  vec3(0, 0, 1 ),
+  vec3( -1, 0, 0 ),
+  vec3( 1, 0, 0 ),
+  vec3( 0, 1, 0 ),
+  vec3( 0, -1, 0)
+);
+
+// Corner (v1 to v4) used by each of the 6 vertices of a quad, for both ways of splitting it
+const int CORNERS[12] = int[](
+  0, 3, 2, 2, 1, 0,
+  3, 2, 1, 1, 0, 3
+);
+
+// Right and forward offset of each corner, faces on odd indices mirror the forward offset
+const ivec2 CORNER_OFFSETS[4] = ivec2[](
+  ivec2(0, 0),
+  ivec2(0, 1),
+  ivec2(1, 1),
+  ivec2(1, 0)
+);
+
+const float CHUNK_SIZE = 62.0;
+const float AO_MIN = 0.3;
+const float AO_PART = (1.0 - AO_MIN) / 3.0;
+
+float calculateAOMultiplier(uint AOLevel) {
+    return AO_MIN + (AOLevel * AO_PART);
+}
+
+void main()
+{
+    uint left = quad.x&uint(63);
+    uint front = (quad.x >> 6)&uint(63);
+    float up = float((quad.x >> 12)&uint(63));
+    // Quads merged across the chunks of a stack keep the top 2 bits of their extents in quad.y
+    uint width = ((quad.x >> 18)&uint(63)) | ((quad.y >> 15)&uint(192));
+    uint height = ((quad.x >> 24)&uint(63)) | ((quad.y >> 17)&uint(192));
+    int flipped = int((quad.x >> 30)&uint(1));
+    isGrass = float((quad.x >> 31)&uint(1));
+
+    uint type = quad.y&uint(255);
+    uint face = (quad.y >> 8)&uint(7);
+
+    ivec2 offset = CORNER_OFFSETS[CORNERS[flipped * 6 + gl_VertexID]];
+    if ((face&uint(1)) == uint(1)) {
+        offset.y = 1 - offset.y;
+    }
+    float right = float(left + uint(offset.x) * width);
+    float forward = float(front + uint(offset.y) * height);
+
+    // AO of the corners is stored as LF, LB, RF, RB
+    uint ao = (quad.y >> (11 + (offset.x * 2 + offset.y) * 2))&uint(3);
+
+    vec3 pos;
+    vec2 tex;
+    if (face < uint(2)) {
+        pos = vec3(right, forward, up);
+        tex = vec2(offset.x * float(width), (1 - offset.y) * float(height));
+    }
+    else if (face < uint(4)) {
+        pos = vec3(up, right, forward);
+        tex = vec2((1 - offset.y) * float(height), (1 - offset.x) * float(width));
+    }
+    else {
+        pos = vec3(forward, up, right);
+        tex = vec2((face == uint(4) ? offset.y : 1 - offset.y) * float(height), (1 - offset.x) * float(width));
+    }
+    // Chunks meshed as one stack share its model matrix and are offset by their index in the stack
+    pos.y += float((quad.y >> 19)&uint(3)) * CHUNK_SIZE;
+
+    FragNormal = NORMALS[face];
+    AOMultiplier = calculateAOMultiplier(ao);
+    TexCoords = vec3(tex, float(type));
+
+    gl_Position = projection * view * model * vec4(pos, 1.0);
+}
+
+#shader fragment
+
+#version 330 core
+
+in float AOMultiplier;
+in vec3 TexCoords;
+flat in ivec3 FragNormal;
+in float isGrass;
+out vec4 FragColor;
+
+uniform sampler2DArray tex_array;
+uniform sampler2D grass_mask;
+uniform vec3 grass_color;
+uniform float ambient;
+
+void main() {
+    vec4 texColor = texture(tex_array, TexCoords);
+
+    if (texColor.a < 0.5) {
+        discard;
+    }
+	
+    // Is grass mask?
+    if (isGrass > 0.5) {
+	if (FragNormal.y == 1) {
+	    texColor.rgb *= grass_color;
+  	}
+        else if (FragNormal.y != -1) {
+            vec4 grass_mask_color = texture(grass_mask, TexCoords.xy);
+            grass_mask_color.rgb *= grass_color;
+            texColor = mix(texColor, grass_mask_color, grass_mask_color.a);
+        }
+    }
+    FragColor = texColor * vec4(vec3(AOMultiplier), 1.0) * ambient;
+}
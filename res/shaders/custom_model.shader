@@ -13,6 +13,7 @@ out float isFoliage;
 out vec3 FragPos;
 
 const float ONE_SIXTEENTH = 1.0/16.0;
+const float CHUNK_SIZE = 62.0;
 
 void main()
 {
@@ -33,6 +34,9 @@ void main()
     float z_fract = (z_packed - (z_whole * 16.0)) * ONE_SIXTEENTH;
     float z = z_whole + z_fract;
 
+    // Chunks meshed as one stack share its model matrix and are offset by their index in the stack
+    y += float((data.x >> 30)&uint(3)) * CHUNK_SIZE;
+
     isFoliage = float((data.y >> 18)&uint(1));
     TexCoords = vec3(
         float(data.y&uint(31)) * ONE_SIXTEENTH,
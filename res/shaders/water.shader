@@ -10,15 +10,19 @@ uniform mat4 projection;
 
 out vec3 TexCoords;
 
+const float CHUNK_SIZE = 62.0;
+
 void main()
 {
     float x = float(data.x&uint(63));
     float y = float((data.x >> 6)&uint(63));
     float z = float((data.x >> 12)&uint(63));
+    // Chunks meshed as one stack share its model matrix and are offset by their index in the stack
+    z += float((data.x >> 20)&uint(3)) * CHUNK_SIZE;
 
     TexCoords = vec3(
 	float(data.y&uint(63)),
-	float((data.y >> 6)&uint(63)),
+	float(((data.y >> 6)&uint(63)) | ((data.y >> 18)&uint(192))),
 	float((data.y >> 12)&uint(255))
     );
 
@@ -0,0 +1,86 @@
+#shader vertex
+
+#version 330 core
+
+// One greedy quad per instance
+layout (location = 0) in uvec2 quad;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 TexCoords;
+
+// Corner (v1 to v4) used by each of the 6 vertices of a quad, for both ways of splitting it
+const int CORNERS[12] = int[](
+  0, 3, 2, 2, 1, 0,
+  3, 2, 1, 1, 0, 3
+);
+
+// Right and forward offset of each corner, faces on odd indices mirror the forward offset
+const ivec2 CORNER_OFFSETS[4] = ivec2[](
+  ivec2(0, 0),
+  ivec2(0, 1),
+  ivec2(1, 1),
+  ivec2(1, 0)
+);
+
+const float CHUNK_SIZE = 62.0;
+
+void main()
+{
+    uint left = quad.x&uint(63);
+    uint front = (quad.x >> 6)&uint(63);
+    float up = float((quad.x >> 12)&uint(63));
+    // Quads merged across the chunks of a stack keep the top 2 bits of their extents in quad.y
+    uint width = ((quad.x >> 18)&uint(63)) | ((quad.y >> 15)&uint(192));
+    uint height = ((quad.x >> 24)&uint(63)) | ((quad.y >> 17)&uint(192));
+    int flipped = int((quad.x >> 30)&uint(1));
+
+    uint type = quad.y&uint(255);
+    uint face = (quad.y >> 8)&uint(7);
+
+    ivec2 offset = CORNER_OFFSETS[CORNERS[flipped * 6 + gl_VertexID]];
+    if ((face&uint(1)) == uint(1)) {
+        offset.y = 1 - offset.y;
+    }
+    float right = float(left + uint(offset.x) * width);
+    float forward = float(front + uint(offset.y) * height);
+
+    vec3 pos;
+    vec2 tex;
+    if (face < uint(2)) {
+        pos = vec3(right, forward, up);
+        tex = vec2(offset.x * float(width), (1 - offset.y) * float(height));
+    }
+    else if (face < uint(4)) {
+        pos = vec3(up, right, forward);
+        tex = vec2((1 - offset.y) * float(height), (1 - offset.x) * float(width));
+    }
+    else {
+        pos = vec3(forward, up, right);
+        tex = vec2((face == uint(4) ? offset.y : 1 - offset.y) * float(height), (1 - offset.x) * float(width));
+    }
+    // Chunks meshed as one stack share its model matrix and are offset by their index in the stack
+    pos.y += float((quad.y >> 19)&uint(3)) * CHUNK_SIZE;
+
+    TexCoords = vec3(tex, float(type));
+
+    gl_Position = projection * view * model * vec4(pos, 1.0);
+}
+
+#shader fragment
+
+#version 330 core
+
+in vec3 TexCoords;
+out vec4 FragColor;
+
+uniform sampler2DArray tex_array;
+uniform vec3 color;
+uniform float ambient;
+
+void main() {
+    vec4 texColor = texture(tex_array, TexCoords); 
+    FragColor = texColor * vec4(color, 1.0) * ambient;
+ }
@@ -13,6 +13,7 @@ License: MIT
 #include <util/Log.hpp>
 #include <util/Util.hpp>
 #include <ui/Crosshair.hpp>
+#include <world/chunk/ChunkBufferPool.hpp>
 
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
@@ -47,6 +48,8 @@ void Game::Run(std::string worldDirectory) {
         // World events
         pWorld->mPlayer.ApplyGravity(*pWorld, mDeltaTime);
         pWorld->GenerateChunks();
+        pWorld->RemeshDirtyChunks();
+        pWorld->UploadRemeshedChunks();
         pWorld->TrySwitchToNextTextureAtlas();
 
         // Delta time calculations
@@ -106,6 +109,9 @@ void Game::SettingsMenu(int potentialDrawCalls, int totalDrawCalls) {
     ImGui::SliderInt("Chunk load distance", &pWorld->mChunkLoadDistance, 3, 30, "%d", ImGuiSliderFlags_NoInput);
     ImGui::SliderInt("Chunk partial load distance", &pWorld->mChunkPartialLoadDistance, 3, 30, "%d", ImGuiSliderFlags_NoInput);
     ImGui::SliderInt("Max tasks per frame", &pWorld->mMaxTasksPerFrame, 1, 50, "%d", ImGuiSliderFlags_NoInput);
+    ImGui::SliderInt("LOD 2x distance", &pWorld->mLodDistances[0], 3, 60, "%d", ImGuiSliderFlags_NoInput);
+    ImGui::SliderInt("LOD 4x distance", &pWorld->mLodDistances[1], 3, 60, "%d", ImGuiSliderFlags_NoInput);
+    ImGui::SliderInt("LOD 8x distance", &pWorld->mLodDistances[2], 3, 60, "%d", ImGuiSliderFlags_NoInput);
 
     glm::ivec3 blockPos = GetWorldBlockPosFromGlobalPos(pWorld->mPlayer.camera.position);
     glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(blockPos);
@@ -118,6 +124,61 @@ void Game::SettingsMenu(int potentialDrawCalls, int totalDrawCalls) {
     ImGui::Text("Potential draw calls: %d", potentialDrawCalls);
     ImGui::Text("Total draw calls: %d", totalDrawCalls);
     ImGui::Text("Time: %f", pWorld->mCurrentTime);
+
+    ChunkBufferPool::Stats poolStats = ChunkBufferPool::GetStats();
+    ImGui::Text("Chunk block memory: %.2f MB (peak %.2f MB, reserved %.2f MB)",
+        static_cast<double>(poolStats.bytesInUse) / (1024.0 * 1024.0),
+        static_cast<double>(poolStats.highWaterMark) / (1024.0 * 1024.0),
+        static_cast<double>(poolStats.bytesReserved) / (1024.0 * 1024.0)
+    );
+    ImGui::Text("Chunk buffer pool hits: %zu misses: %zu", poolStats.hits, poolStats.misses);
+    bool hugePages = ChunkBufferPool::IsHugePagesEnabled();
+    if (ImGui::Checkbox("Huge pages for new chunk buffers", &hugePages)) {
+        ChunkBufferPool::SetHugePagesEnabled(hugePages);
+    }
+
+    ChunkMesher::MeshTimings meshTimings = ChunkMesher::GetMeshTimings();
+    ImGui::Text("Greedy mesh time: %.1f us per chunk (%zu chunks)",
+        meshTimings.calls > 0 ? meshTimings.totalMicroseconds / static_cast<double>(meshTimings.calls) : 0.0,
+        meshTimings.calls
+    );
+    if (ImGui::Button("Reset mesh timings")) {
+        ChunkMesher::ResetMeshTimings();
+    }
+    if (ChunkMesher::IsSIMDClassifySupported()) {
+        bool simdClassify = ChunkMesher::IsSIMDClassifyEnabled();
+        if (ImGui::Checkbox("AVX2 voxel classification", &simdClassify)) {
+            ChunkMesher::SetSIMDClassifyEnabled(simdClassify);
+        }
+    }
+    ImGui::Text("Mesher heap allocations: %zu", ChunkMesher::GetAllocationCount());
+    ImGui::Checkbox("Mesh edited chunks on several threads", &pWorld->mParallelEditMeshing);
+    ImGui::Text("Edit to visible latency: %.2f ms (max %.2f ms)", pWorld->mLastEditLatency * 1000.0, pWorld->mMaxEditLatency * 1000.0);
+    ImGui::Text("Edit remeshes: %zu for %zu chunk edits (%zu saved)", pWorld->mEditRemeshes, pWorld->mChunkEdits, pWorld->mChunkEdits - pWorld->mEditRemeshes);
+    ImGui::Text("Block snapshot copies: %zu", GetBlockSnapshotCopies());
+    StaleMeshStats staleMeshes = GetStaleMeshStats();
+    ImGui::Text("Stale meshes cancelled: %zu, discarded: %zu", staleMeshes.cancelled, staleMeshes.discarded);
+    ImGui::Text("Enclosed chunks skipped: %zu", pWorld->mEnclosedChunksSkipped);
+    GreedyDrawStats greedyDrawStats = GetGreedyDrawStats();
+    ImGui::Text("Greedy quads drawn: %zu (%zu facing away skipped)", greedyDrawStats.drawn, greedyDrawStats.culled);
+    std::shared_ptr<Chunk> cameraChunk = pWorld->GetChunk(chunkPos);
+    if (cameraChunk != nullptr && ImGui::TreeNode("Chunk block histogram")) {
+        const BlockHistogram& histogram = cameraChunk->GetBlockHistogram();
+        for (std::size_t i = 0; i < static_cast<std::size_t>(BlockType::NUM_BLOCKS); i++) {
+            BlockType type = static_cast<BlockType>(i);
+            if (histogram.GetCount(type) > 0) {
+                ImGui::Text("%s: %d", GetBlockData(type).name.c_str(), histogram.GetCount(type));
+            }
+        }
+        if (histogram.waterLogged > 0) {
+            ImGui::Text("waterlogged: %d", histogram.waterLogged);
+        }
+        ImGui::TreePop();
+    }
+    if (ChunkStack::IsStackMeshing()) {
+        ImGui::Text("Stack mesh quads: %zu (%zu meshed per chunk, %zu merged across chunks)",
+            pWorld->mStackMeshQuads, pWorld->mChunkMeshQuads, pWorld->mChunkMeshQuads - pWorld->mStackMeshQuads);
+    }
     ImGui::End();
 }
 
@@ -308,7 +308,19 @@ Q - Quit
     } while (choice != 'q');
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Mesh format and stack meshing have to be chosen before any world is loaded
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--quad-instances") {
+            ChunkMesher::SetMeshFormat(ChunkMesher::MeshFormat::QUAD_INSTANCES);
+            LOG_INFO("Using quad instance chunk mesh format");
+        }
+        else if (std::string(argv[i]) == "--stack-meshing") {
+            ChunkStack::SetStackMeshing(true);
+            LOG_INFO("Meshing and drawing whole chunk stacks");
+        }
+    }
+
     try{
         run();
     }
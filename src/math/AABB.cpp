@@ -11,10 +11,11 @@ bool BoundingBox::IsColliding(const World& world, glm::vec3 center)
     glm::ivec3 corner1 = GetWorldBlockPosFromGlobalPos(center + localPos - size);
     glm::ivec3 corner2 = GetWorldBlockPosFromGlobalPos(center + localPos + size);
 
+    BlockReader reader(world);
     for (int x = corner1.x; x <= corner2.x; x++) {
         for (int y = corner1.y; y <= corner2.y; y++) {
             for (int z = corner1.z; z <= corner2.z; z++) {
-                Block block = world.GetBlock(glm::ivec3(x,y,z));
+                Block block = reader.GetBlock(glm::ivec3(x,y,z));
                 BlockType type = block.GetType();
                 if (type != BlockType::AIR && GetBlockData(type).collision) {
                     return true;
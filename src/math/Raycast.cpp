@@ -7,6 +7,17 @@ License: MIT
 #include <world/World.hpp>
 #include <util/Log.hpp>
 
+// Result for the block the ray stops in, taking a reference to its chunk
+static Raycaster::BlockRaycastResult GetRaycastResult(const World& world, const BlockReader& reader, glm::ivec3 blockPos, glm::ivec3 normal, Block block)
+{
+    return Raycaster::BlockRaycastResult{
+        reader.GetChunk() != nullptr ? world.GetChunk(reader.GetChunk()->GetPosition()) : nullptr,
+        GetChunkBlockPosFromGlobalBlockPos(blockPos),
+        normal,
+        block
+    };
+}
+
 Raycaster::BlockRaycastResult Raycaster::BlockRaycast(const World& world, glm::vec3 start, glm::vec3 direction, float distance)
 {
     glm::vec3 end = start + direction * distance;
@@ -50,35 +61,23 @@ Raycaster::BlockRaycastResult Raycaster::BlockRaycast(const World& world, glm::v
         ((start[2] > end[2]) ? (start[2] - min[2]) : (max[2] - start[2])) * deltat[2]
     );
 
+    // Steps mostly stay in the same chunk, so it is only looked up again on leaving it
+    BlockReader reader(world);
     while (true)
     {
-        glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(currentBlock);
-        std::shared_ptr<Chunk> chunk = world.GetChunk(chunkPos);
-        glm::ivec3 blockPosInChunk = GetChunkBlockPosFromGlobalBlockPos(currentBlock);
-        if (chunk != nullptr) {
+        Block block = reader.GetBlock(currentBlock);
+        if (reader.GetChunk() != nullptr) {
             // If we do hit a chunk, check if its air. If it's not then we stop the raycasting otherwise we continue
-            Block block = chunk->GetBlock(blockPosInChunk);
             BlockType type = block.GetType();
             if (!GetBlockData(type).canInteractThrough || block.IsWaterLogged()) {
-                return BlockRaycastResult{
-                    chunk,
-                    blockPosInChunk,
-                    normal,
-                    block
-                };
+                return GetRaycastResult(world, reader, currentBlock, normal, block);
             }
         }
         // Raycasting
         if (t[0] <= t[1] && t[0] <= t[2])
         {
             if (currentBlock[0] == endBlock[0]) {
-                Block block = chunk != nullptr ? chunk->GetBlock(blockPosInChunk) : Block(BlockType::AIR, 0, false);
-                return BlockRaycastResult{
-                    chunk,
-                    blockPosInChunk,
-                    normal,
-                    block
-                };
+                return GetRaycastResult(world, reader, currentBlock, normal, block);
             };
             t[0] += deltat[0];
             normal = glm::ivec3(
@@ -89,13 +88,7 @@ Raycaster::BlockRaycastResult Raycaster::BlockRaycast(const World& world, glm::v
         else if (t[1] <= t[2])
         {
             if (currentBlock[1] == endBlock[1]) {
-                Block block = chunk != nullptr ? chunk->GetBlock(blockPosInChunk) : Block(BlockType::AIR, 0, false);
-                return BlockRaycastResult{
-                    chunk,
-                    blockPosInChunk,
-                    normal,
-                    block
-                };
+                return GetRaycastResult(world, reader, currentBlock, normal, block);
             };
             t[1] += deltat[1];
             normal = glm::ivec3(
@@ -106,13 +99,7 @@ Raycaster::BlockRaycastResult Raycaster::BlockRaycast(const World& world, glm::v
         else
         {
             if (currentBlock[2] == endBlock[2]) {
-                Block block = chunk != nullptr ? chunk->GetBlock(blockPosInChunk) : Block(BlockType::AIR, 0, false);
-                return BlockRaycastResult{
-                    chunk,
-                    blockPosInChunk,
-                    normal,
-                    block
-                };
+                return GetRaycastResult(world, reader, currentBlock, normal, block);
             };
             t[2] += deltat[2];
             normal = glm::ivec3(
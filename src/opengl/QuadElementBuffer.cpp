@@ -0,0 +1,95 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#include <opengl/QuadElementBuffer.hpp>
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+QuadElementBuffer::QuadElementBuffer(std::size_t initialQuadCapacity)
+{
+    Reserve(initialQuadCapacity);
+}
+
+void QuadElementBuffer::Reserve(std::size_t quadCount)
+{
+    if (quadCount <= mQuadCapacity) return;
+
+    // Grow geometrically so a few large meshes don't rebuild the buffer each time
+    std::size_t capacity = std::max(quadCount, mQuadCapacity * 2);
+    std::vector<uint32_t> indices(capacity * INDICES_PER_QUAD);
+    for (std::size_t quad = 0; quad < capacity; quad++) {
+        uint32_t first = static_cast<uint32_t>(quad * VERTICES_PER_QUAD);
+        uint32_t* quadIndices = &indices[quad * INDICES_PER_QUAD];
+        quadIndices[0] = first;
+        quadIndices[1] = first + 1;
+        quadIndices[2] = first + 2;
+        quadIndices[3] = first + 2;
+        quadIndices[4] = first + 3;
+        quadIndices[5] = first;
+    }
+    mEBO.BufferData(indices.data(), indices.size() * sizeof(uint32_t), GL_STATIC_DRAW);
+    mQuadCapacity = capacity;
+}
+
+void QuadElementBuffer::Bind() const
+{
+    mEBO.Bind();
+}
+
+void QuadElementBuffer::Draw(std::size_t quadCount)
+{
+    Reserve(quadCount);
+    // The element array binding is part of the vertex array state, so bind it to whichever array is bound
+    Bind();
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(quadCount * INDICES_PER_QUAD), GL_UNSIGNED_INT, nullptr);
+}
+
+void QuadElementBuffer::Draw(const std::vector<QuadRange>& ranges)
+{
+    if (ranges.empty()) return;
+    std::size_t quadCount = 0;
+    for (const QuadRange& range : ranges) {
+        quadCount = std::max(quadCount, range.first + range.count);
+    }
+    Reserve(quadCount);
+    Bind();
+
+    // Only drawn from the main thread, so the argument arrays are reused between calls
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    counts.clear();
+    offsets.clear();
+    for (const QuadRange& range : ranges) {
+        counts.push_back(static_cast<GLsizei>(range.count * INDICES_PER_QUAD));
+        offsets.push_back(reinterpret_cast<const void*>(range.first * INDICES_PER_QUAD * sizeof(uint32_t)));
+    }
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), static_cast<GLsizei>(ranges.size()));
+}
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#ifndef QUAD_ELEMENT_BUFFER_H
+#define QUAD_ELEMENT_BUFFER_H
+
+#include <glad/glad.h>
+#include <opengl/BufferObject.hpp>
+#include <cstddef>
+#include <vector>
+
+/*
+Element buffer drawing every 4 consecutive vertices of a vertex array as a quad, made of the triangles
+(0, 1, 2) and (2, 3, 0). A single instance can be shared by any number of vertex arrays and grows to fit
+the largest number of quads drawn with it.
+*/
+class QuadElementBuffer {
+public:
+    struct QuadRange {
+        std::size_t first;
+        std::size_t count;
+    };
+private:
+    ElementBuffer mEBO;
+    std::size_t mQuadCapacity = 0;
+public:
+    static constexpr std::size_t VERTICES_PER_QUAD = 4;
+    static constexpr std::size_t INDICES_PER_QUAD = 6;
+    QuadElementBuffer(std::size_t initialQuadCapacity);
+    // Grow the buffer so it can index at least quadCount quads
+    void Reserve(std::size_t quadCount);
+    void Bind() const;
+    // Draw the first quadCount quads of the currently bound vertex array
+    void Draw(std::size_t quadCount);
+    // Draw several ranges of quads of the currently bound vertex array in one call
+    void Draw(const std::vector<QuadRange>& ranges);
+};
+
+#endif // !QUAD_ELEMENT_BUFFER_H
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -32,12 +32,12 @@ VertexArray& VertexArray::operator=(VertexArray&& other) noexcept
     return *this;
 }
 
-void VertexArray::AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& layout)
+void VertexArray::AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& layout, uintptr_t baseOffset)
 {
     Bind();
     vb.Bind();
-    std::vector<VertexBufferLayoutElement> elements = layout.GetElements();
-    uintptr_t offset = 0;
+    const std::vector<VertexBufferLayoutElement>& elements = layout.GetElements();
+    uintptr_t offset = baseOffset;
     for (std::size_t i = 0; i < elements.size(); i++) {
         const VertexBufferLayoutElement element = elements[i];
         glEnableVertexAttribArray(static_cast<GLuint>(i));
@@ -48,6 +48,9 @@ void VertexArray::AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& la
         else {
             glVertexAttribPointer(static_cast<GLuint>(i), element.count, element.type, element.normalized, layout.GetStride(), (const void*)(offset));
         }
+        if (layout.GetDivisor() != 0) {
+            glVertexAttribDivisor(static_cast<GLuint>(i), layout.GetDivisor());
+        }
         offset += element.count * VertexBufferLayoutElement::GetSize(element.type);
     }
 }
@@ -7,6 +7,7 @@ License: MIT
 #define VERTEX_ARRAY_H
 
 #include <glad/glad.h>
+#include <cstdint>
 #include <opengl/BufferObject.hpp>
 #include <opengl/VertexBufferLayout.hpp>
 
@@ -21,7 +22,9 @@ public:
     VertexArray(VertexArray&& other) noexcept;
     VertexArray& operator=(VertexArray&& other) noexcept;
 
-    void AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& layout);
+    // The attributes start baseOffset bytes into the buffer. Adding the same buffer again at another offset is how
+    // instanced attributes are pointed at part of it, as there is no base instance before OpenGL 4.2
+    void AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& layout, uintptr_t baseOffset = 0);
     void Bind() const;
     void Unbind() const;
 };
@@ -26,7 +26,7 @@ void VertexBufferLayout::AddAttribute<int>(unsigned int count)
     uStride += VertexBufferLayoutElement::GetSize(GL_INT) * count;
 }
 
-std::vector<VertexBufferLayoutElement> VertexBufferLayout::GetElements() const
+const std::vector<VertexBufferLayoutElement>& VertexBufferLayout::GetElements() const
 {
     return mElements;
 }
@@ -36,6 +36,16 @@ unsigned int VertexBufferLayout::GetStride() const
     return uStride;
 }
 
+void VertexBufferLayout::SetDivisor(unsigned int divisor)
+{
+    uDivisor = divisor;
+}
+
+unsigned int VertexBufferLayout::GetDivisor() const
+{
+    return uDivisor;
+}
+
 /*
 MIT License
 
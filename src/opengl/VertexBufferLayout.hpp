@@ -33,10 +33,14 @@ public:
     template <typename T>
     void AddAttribute(unsigned int count);
 
-    std::vector<VertexBufferLayoutElement> GetElements() const;
+    const std::vector<VertexBufferLayoutElement>& GetElements() const;
     unsigned int GetStride() const;
+    // Advance the attributes once every divisor instances rather than once per vertex, 0 disables instancing
+    void SetDivisor(unsigned int divisor);
+    unsigned int GetDivisor() const;
 private:
     unsigned int uStride{};
+    unsigned int uDivisor{};
     std::vector<VertexBufferLayoutElement> mElements{};
 };
 
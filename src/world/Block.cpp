@@ -50,6 +50,17 @@ bool Block::operator!=(Block block) const
     return data != block.data;
 }
 
+void BlockHistogram::Add(Block block, int count)
+{
+    counts[static_cast<std::size_t>(block.GetType())] += count;
+    if (block.IsWaterLogged()) waterLogged += count;
+}
+
+int BlockHistogram::GetCount(BlockType type) const
+{
+    return counts[static_cast<std::size_t>(type)];
+}
+
 BlockDataStruct BlockData[static_cast<std::size_t>(BlockType::NUM_BLOCKS)] = {};
 BlockSoundStruct BlockSounds[static_cast<std::size_t>(Sound::NUM_SOUNDS)] = {};
 BlockModel BlockModels[static_cast<std::size_t>(Model::NUM_MODELS)] = {};
@@ -63,6 +74,7 @@ void LoadBlockData() {
     for (YAML::const_iterator it = blocks_yml.begin(); it != blocks_yml.end(); ++it) {
         BlockDataStruct blockData{};
 
+        blockData.name = it->first.as<std::string>();
         uint8_t uniqueFacesCount = it->second["unique_faces"].as<uint8_t>();
         blockData.unique_faces = uniqueFacesCount;
         blockData.breakSoundID = it->second["break_sound_id"].as<SoundID>();
@@ -112,7 +124,7 @@ void LoadBlockData() {
             break;
         }
         }
-        BlockData[block_count] = blockData;
+        BlockData[block_count] = std::move(blockData);
         face_index += uniqueFacesCount;
         block_count++;
     }
@@ -139,21 +151,16 @@ void LoadBlockSoundData() {
 
 void LoadBlockModels() {
     BlockModels[static_cast<std::size_t>(Model::CUBE)] = {};
+    // Models are made of quads, 4 vertices each, drawn with the shared quad index buffer
     BlockModels[static_cast<std::size_t>(Model::CROSS)] = {
         0, 0, 0, 0, 16, 0, 0,
         16, 0, 16, 16, 16, 0, 0,
         16, 16, 16, 16, 0, 0, 0,
-
-        0, 0, 0, 0, 16, 0, 0,
-        16, 16, 16, 16, 0, 0, 0,
         0, 16, 0, 0, 0, 0, 0,
 
         0, 0, 16, 16, 16, 0, 0,
         16, 0, 0, 0, 16, 0, 0,
         16, 16, 0, 0, 0, 0, 0,
-
-        0, 0, 16, 16, 16, 0, 0,
-        16, 16, 0, 0, 0, 0, 0,
         0, 16, 16, 16, 0, 0, 0
     };
 }
@@ -52,6 +52,17 @@ public:
     bool operator!=(Block block) const;
 };
 
+// Number of blocks of each type in a volume, indexed by the whole 8 bit type so no block can index out of bounds.
+// Waterlogged blocks are counted again on their own
+struct BlockHistogram {
+    std::array<int, 256> counts{};
+    int waterLogged = 0;
+
+    // Count a block, or uncount it with a negative count
+    void Add(Block block, int count = 1);
+    int GetCount(BlockType type) const;
+};
+
 enum class Sound : SoundID {
     AIR,
     GRASS,
@@ -80,6 +91,7 @@ enum BlockFaces {
 };
 
 struct BlockDataStruct {
+    std::string name;
     uint8_t unique_faces;
     std::array<TextureID, 6> faces;
     SoundID breakSoundID;
@@ -64,7 +64,7 @@ void Player::KeyCallback(int key, int scancode, int action, int mods)
     }
 }
 
-void Player::MouseCallback(const World& world, int button, int action, int mods)
+void Player::MouseCallback(World& world, int button, int action, int mods)
 {
     UNUSED(mods);
 
@@ -77,14 +77,13 @@ void Player::MouseCallback(const World& world, int button, int action, int mods)
             if (raycast.chunk != nullptr && !blockData.canInteractThrough) {
                 // Update chunk block was broken in
                 if (!blockData.canInteractThrough) {
+                    glm::ivec3 blockPos = GetGlobalBlockPosFromChunkBlockPos(raycast.chunk->GetPosition(), raycast.blockPos);
                     if (raycast.blockHit.IsWaterLogged()) {
-                        raycast.chunk->SetBlock(raycast.blockPos, Block(BlockType::WATER, 0, false));
+                        world.SetBlockAndRemesh(blockPos, Block(BlockType::WATER, 0, false));
                     }
                     else {
-                        raycast.chunk->SetBlock(raycast.blockPos, Block(BlockType::AIR, 0, false));
+                        world.SetBlockAndRemesh(blockPos, Block(BlockType::AIR, 0, false));
                     }
-                    raycast.chunk->CreateMesh();
-                    raycast.chunk->BufferData();
                     BlockSoundStruct soundData = BlockSounds[blockData.breakSoundID];
                     SoundEngine::GetEngine()->play3D(soundData.sounds[rand() % soundData.sounds.size()].c_str(), glm_vec3_to_irrklang_vec3df(camera.position));
                 }
@@ -103,30 +102,30 @@ void Player::MouseCallback(const World& world, int button, int action, int mods)
             const BlockDataStruct& selectedBlockData = GetBlockData(selectedBlockType);
 
             if (raycast.chunk != nullptr) {
+                glm::ivec3 blockHitPosition = GetGlobalBlockPosFromChunkBlockPos(raycast.chunk->GetPosition(), raycast.blockPos);
                 // if we are placing water in a waterloggable block
                 if (selectedBlockType == BlockType::WATER && hitBlockData.waterloggable && !raycast.blockHit.IsWaterLogged()) {
-                    raycast.chunk->SetBlock(raycast.blockPos, Block(raycast.blockHit.GetType(), 0, true));
+                    world.SetBlockAndRemesh(blockHitPosition, Block(raycast.blockHit.GetType(), 0, true));
                 }
                 else if (!hitBlockData.canInteractThrough) {
-                    glm::ivec3 blockPlacePosition = raycast.blockPos + raycast.normal;
-                    Block blockBeforePlace = raycast.chunk->GetBlock(blockPlacePosition);
+                    glm::ivec3 blockPlacePosition = blockHitPosition + raycast.normal;
+                    Block blockBeforePlace = world.GetBlock(blockPlacePosition);
 
                     // If we are placing a waterloggable block in a water block
                     if (selectedBlockData.waterloggable && blockBeforePlace.GetType() == BlockType::WATER) {
-                        raycast.chunk->SetBlock(blockPlacePosition, Block(selectedBlockType, 0, true));
+                        world.SetBlock(blockPlacePosition, Block(selectedBlockType, 0, true));
                     }
                     else {
-                        raycast.chunk->SetBlock(blockPlacePosition, Block(selectedBlockType, 0, false));
+                        world.SetBlock(blockPlacePosition, Block(selectedBlockType, 0, false));
                     }
 
                     if (boundingBox.IsColliding(world, camera.position)) {
-                        raycast.chunk->SetBlock(blockPlacePosition, blockBeforePlace);
+                        world.SetBlock(blockPlacePosition, blockBeforePlace);
                         return;
                     }
+                    world.MarkBlockDirty(blockPlacePosition);
                 }
             }
-            raycast.chunk->CreateMesh();
-            raycast.chunk->BufferData();
             const BlockDataStruct& blockData = GetBlockData(selectedBlockType);
             BlockSoundStruct soundData = BlockSounds[blockData.placeSoundID];
             SoundEngine::GetEngine()->play3D(soundData.sounds[rand() % soundData.sounds.size()].c_str(), glm_vec3_to_irrklang_vec3df(camera.position));
@@ -39,7 +39,7 @@ struct Player {
     BoundingBox boundingBox{ glm::vec3(0.4f, 0.95f, 0.4f), glm::vec3(0.0f, -0.75f, 0.0f) };
     void ProcessKeyInput(const World& world, const Window& window, float deltaTime);
     void KeyCallback(int key, int scancode, int action, int mods);
-    void MouseCallback(const World& world, int button, int action, int mods);
+    void MouseCallback(World& world, int button, int action, int mods);
     void Move(const World& world, PlayerMovement direction, float speed, float deltaTime);
     void ApplyGravity(const World&, float deltaTime);
 };
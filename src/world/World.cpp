@@ -9,6 +9,7 @@ License: MIT
 #include <fmt/format.h>
 #include <util/IO.hpp>
 #include <chrono>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 
 glm::ivec3 GetWorldBlockPosFromGlobalPos(glm::vec3 globalPosition)
@@ -20,24 +21,72 @@ glm::ivec3 GetWorldBlockPosFromGlobalPos(glm::vec3 globalPosition)
      );
 }
 
+// Floor of pos / Chunk::SIZE for either sign, without a sign branch. Biasing by a multiple of the size makes every int
+// non negative, and an unsigned division by a constant compiles to a multiply and shift. The bias is 2^32 chunks, so
+// truncating the quotient to 32 bits removes it
+static int FloorDivChunkSize(int pos)
+{
+    constexpr int64_t BIAS = static_cast<int64_t>(Chunk::SIZE) << 32;
+    return static_cast<int>(static_cast<uint32_t>(static_cast<uint64_t>(pos + BIAS) / Chunk::SIZE));
+}
+
 glm::ivec3 GetChunkPosFromGlobalBlockPos(glm::ivec3 globalBlockPos)
 {
     return glm::ivec3(
-        globalBlockPos.x < 0 ? ((globalBlockPos.x + 1) / Chunk::SIZE) - 1 : globalBlockPos.x / Chunk::SIZE,
-        globalBlockPos.y < 0 ? ((globalBlockPos.y + 1) / Chunk::SIZE) - 1 : globalBlockPos.y / Chunk::SIZE,
-        globalBlockPos.z < 0 ? ((globalBlockPos.z + 1) / Chunk::SIZE) - 1 : globalBlockPos.z / Chunk::SIZE
+        FloorDivChunkSize(globalBlockPos.x),
+        FloorDivChunkSize(globalBlockPos.y),
+        FloorDivChunkSize(globalBlockPos.z)
     );
 }
 
+// Position of a block in its chunk along one axis. Blocks inside a chunk start at 1, after the padding. Done per
+// component, as glm's ivec3 arithmetic doesn't reduce to plain registers
+static int ChunkBlockCoord(int pos)
+{
+    return pos - FloorDivChunkSize(pos) * Chunk::SIZE + 1;
+}
+
 glm::ivec3 GetChunkBlockPosFromGlobalBlockPos(glm::ivec3 globalBlockPos)
 {
     return glm::ivec3(
-        globalBlockPos.x < 0 ? Chunk::SIZE_PADDED_SUB_1 - (1 + (abs(globalBlockPos.x) - 1) % Chunk::SIZE) : 1 + (globalBlockPos.x % Chunk::SIZE),
-        globalBlockPos.y < 0 ? Chunk::SIZE_PADDED_SUB_1 - (1 + (abs(globalBlockPos.y) - 1) % Chunk::SIZE) : 1 + (globalBlockPos.y % Chunk::SIZE),
-        globalBlockPos.z < 0 ? Chunk::SIZE_PADDED_SUB_1 - (1 + (abs(globalBlockPos.z) - 1) % Chunk::SIZE) : 1 + (globalBlockPos.z % Chunk::SIZE)
+        ChunkBlockCoord(globalBlockPos.x),
+        ChunkBlockCoord(globalBlockPos.y),
+        ChunkBlockCoord(globalBlockPos.z)
     );
 }
 
+glm::ivec3 GetGlobalBlockPosFromChunkBlockPos(glm::ivec3 chunkPos, glm::ivec3 chunkBlockPos)
+{
+    return (chunkPos * Chunk::SIZE) + chunkBlockPos - glm::ivec3(1);
+}
+
+// Every chunk holding a copy of a block: the chunk it lies in, and the neighbours whose padding it is part of when
+// it lies on a face, edge or corner of that chunk
+struct BlockCopy {
+    glm::ivec3 chunkPos;
+    glm::ivec3 blockPos;
+};
+
+static std::vector<BlockCopy> GetBlockCopies(glm::ivec3 pos)
+{
+    glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(pos);
+    glm::ivec3 blockPos = GetChunkBlockPosFromGlobalBlockPos(pos);
+    std::vector<BlockCopy> copies;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int z = -1; z <= 1; z++) {
+                glm::ivec3 offset(x, y, z);
+                glm::ivec3 copyPos = blockPos - (offset * Chunk::SIZE);
+                if (copyPos.x >= 0 && copyPos.x < Chunk::SIZE_PADDED &&
+                    copyPos.y >= 0 && copyPos.y < Chunk::SIZE_PADDED &&
+                    copyPos.z >= 0 && copyPos.z < Chunk::SIZE_PADDED) {
+                    copies.push_back(BlockCopy{ chunkPos + offset, copyPos });
+                }
+            }
+        }
+    }
+    return copies;
+}
 
 World::World(std::string worldDirectory) : mWorldDirectory(worldDirectory)
 {
@@ -84,6 +133,7 @@ World::World(std::string worldDirectory) : mWorldDirectory(worldDirectory)
             if (radius < mChunkLoadDistance) {
                 auto emplace = mChunkStacks.emplace(pos, pos);
                 ChunkStack& chunkStack = emplace.first->second;
+                LinkChunkStack(chunkStack);
                 chunkStack.state = ChunkStackState::LOADED;
                 mTaskPool.push_task([this, worldDirectory, &chunkStack]() {
                     chunkStack.FullyLoad(worldDirectory, mSeed, mPerlin);
@@ -92,9 +142,11 @@ World::World(std::string worldDirectory) : mWorldDirectory(worldDirectory)
             else if (radius <= totalRenderDistance) {
                 auto emplace = mChunkStacks.emplace(pos, pos);
                 ChunkStack& chunkStack = emplace.first->second;
+                LinkChunkStack(chunkStack);
                 chunkStack.state = ChunkStackState::PARTIALLY_LOADED;
-                mTaskPool.push_task([this, worldDirectory, &chunkStack]() {
-                    chunkStack.PartiallyLoad(worldDirectory, mSeed, mPerlin);
+                int lodScale = GetLodScale(radius);
+                mTaskPool.push_task([this, worldDirectory, &chunkStack, lodScale]() {
+                    chunkStack.PartiallyLoad(worldDirectory, mSeed, mPerlin, lodScale);
                     });
             }
         }
@@ -103,9 +155,7 @@ World::World(std::string worldDirectory) : mWorldDirectory(worldDirectory)
 
     // Buffer all chunks
     for (auto& [pos, stack] : mChunkStacks) {
-        for (auto it = stack.begin(); it != stack.end(); ++it) {
-            (*it)->BufferData();
-        }
+        stack.BufferData();
     }
     mWorldLoadedTime = glfwGetTime();
 }
@@ -113,6 +163,7 @@ World::World(std::string worldDirectory) : mWorldDirectory(worldDirectory)
 World::~World() {
     mTaskPool.purge();
     mTaskPool.wait_for_tasks();
+    mRemeshPool.wait_for_tasks();
 
     // Save to disk
     if (!WriteStructToDisk(fmt::format("{}/world.data", mWorldDirectory), WorldSave{
@@ -164,11 +215,25 @@ void World::Draw(const Frustum& frustum, int* totalChunks, int* chunksDrawn)
         ambientTerrainLight = 0.2f + ((static_cast<float>(currentDayProgress) - 0.91f) / 0.09f) * 0.5f;
     }
 
-    // Update chunk visibilities by performing frustum culling
+    // Update chunk visibilities by performing frustum culling. Enclosed chunks can only be seen from inside
+    glm::ivec3 cameraChunkPos = GetCameraChunkPos();
+    mStackMeshQuads = 0;
+    mChunkMeshQuads = 0;
+    mEnclosedChunksSkipped = 0;
+    ResetGreedyDrawStats();
     for (auto& [pos, chunkStack] : mChunkStacks) {
         for (auto it = chunkStack.begin(); it != chunkStack.end(); ++it) {
-            (*it)->UpdateVisiblity(frustum);
+            std::shared_ptr<Chunk>& chunk = *it;
+            if (chunk->IsEnclosed() && chunk->GetPosition() != cameraChunkPos) {
+                chunk->visible = false;
+                mEnclosedChunksSkipped++;
+                continue;
+            }
+            chunk->UpdateVisiblity(frustum, mPlayer.camera.position);
         }
+        chunkStack.UpdateCameraFacingFaces(mPlayer.camera.position);
+        mStackMeshQuads += chunkStack.GetStackQuadCount();
+        mChunkMeshQuads += chunkStack.GetChunkQuadCount();
     }
 
     glDepthFunc(GL_LEQUAL);
@@ -191,7 +256,7 @@ void World::Draw(const Frustum& frustum, int* totalChunks, int* chunksDrawn)
     mChunkShader.SetInt("grass_mask", 1);
  
     for (auto& [pos, stack] : mChunkStacks) {
-        stack.Draw(mChunkShader, totalChunks, chunksDrawn);
+        stack.Draw(mChunkShader, mQuadIndices, totalChunks, chunksDrawn);
     }
 
     // Draw custom models
@@ -204,7 +269,7 @@ void World::Draw(const Frustum& frustum, int* totalChunks, int* chunksDrawn)
     mCustomModelShader.SetVec3("foliage_color", mFoliageColor);
     mCustomModelShader.SetFloat("ambient", ambientTerrainLight);
     for (auto& [pos, stack] : mChunkStacks) {
-        stack.DrawCustomModel(mCustomModelShader, totalChunks, chunksDrawn);
+        stack.DrawCustomModel(mCustomModelShader, mQuadIndices, totalChunks, chunksDrawn);
     }
     glEnable(GL_CULL_FACE);
 
@@ -218,7 +283,7 @@ void World::Draw(const Frustum& frustum, int* totalChunks, int* chunksDrawn)
     mWaterShader.SetInt("tex_array", 0);
     glEnable(GL_BLEND);
     for (auto& [pos, stack] : mChunkStacks) {
-        stack.DrawWater(mWaterShader, totalChunks, chunksDrawn);
+        stack.DrawWater(mWaterShader, mQuadIndices, totalChunks, chunksDrawn);
     }
     glDisable(GL_BLEND);
 }
@@ -258,6 +323,7 @@ void World::GenerateChunks()
     }
     mUnloadPool.wait_for_tasks();
     for (auto it : iteratorsToRemove) {
+        UnlinkChunkStack(it->second);
         mChunkStacks.erase(it);
     }
 
@@ -284,6 +350,7 @@ void World::GenerateChunks()
                     if (tasks < mMaxTasksPerFrame) {
                         auto emplace = mChunkStacks.emplace(pos, pos);
                         ChunkStack& stack = emplace.first->second;
+                        LinkChunkStack(stack);
                         tasks++;
                         stack.is_in_task = true;
                         mTaskPool.push_task([this, &stack] {
@@ -313,30 +380,24 @@ void World::GenerateChunks()
                     }
 
                     // Buffer any chunks in it if necessary
-                    for (auto& chunk : stack) {
-                        if (chunk->needsBuffering) {
-                            if (tasks < mMaxTasksPerFrame) {
-                                tasks++;
-                                chunk->BufferData();
-                            }
-                            else {
-                                return;
-                            }
-                        }
+                    if (!BufferChunkStack(stack, tasks)) {
+                        return;
                     }
                 }
             }
             // Outer radius (partial chunk loading)
             else {
+                int lodScale = GetLodScale(radius);
                 // If no chunk found, create chunk and partially load
                 if (find == mChunkStacks.end()) {
                     if (tasks < mMaxTasksPerFrame) {
                         auto emplace = mChunkStacks.emplace(pos, pos);
                         ChunkStack& stack = emplace.first->second;
+                        LinkChunkStack(stack);
                         tasks++;
                         stack.is_in_task = true;
-                        mTaskPool.push_task([this, &stack] {
-                            stack.PartiallyLoad(mWorldDirectory, mSeed, mPerlin);
+                        mTaskPool.push_task([this, &stack, lodScale] {
+                            stack.PartiallyLoad(mWorldDirectory, mSeed, mPerlin, lodScale);
                             stack.is_in_task = false;
                             });
                     }
@@ -345,14 +406,16 @@ void World::GenerateChunks()
                     }
                 }
                 else {
-                    // If chunk is found, downgrade from loaded loaded to partially loaded
+                    // If chunk is found, downgrade from loaded loaded to partially loaded, or remesh it at the
+                    // level of detail for its new radius
                     ChunkStack& stack = find->second;
-                    if (stack.state == ChunkStackState::LOADED && !stack.is_in_task) {
+                    bool lodChanged = stack.state == ChunkStackState::PARTIALLY_LOADED && stack.GetLodScale() != lodScale;
+                    if ((stack.state == ChunkStackState::LOADED || lodChanged) && !stack.is_in_task) {
                         if (tasks < mMaxTasksPerFrame) {
                             tasks++;
                             stack.is_in_task = true;
-                            mTaskPool.push_task([this, &stack] {
-                                stack.PartiallyLoad(mWorldDirectory, mSeed, mPerlin);
+                            mTaskPool.push_task([this, &stack, lodScale] {
+                                stack.PartiallyLoad(mWorldDirectory, mSeed, mPerlin, lodScale);
                                 stack.is_in_task = false;
                                 });
                         }
@@ -362,16 +425,8 @@ void World::GenerateChunks()
                     }
 
                     // Buffer any chunks in it if necessary
-                    for (auto& chunk : stack) {
-                        if (chunk->needsBuffering) {
-                            if (tasks < mMaxTasksPerFrame) {
-                                tasks++;
-                                chunk->BufferData();
-                            }
-                            else {
-                                return;
-                            }
-                        }    
+                    if (!BufferChunkStack(stack, tasks)) {
+                        return;
                     }
                 }
             }
@@ -379,6 +434,35 @@ void World::GenerateChunks()
     }
 }
 
+bool World::BufferChunkStack(ChunkStack& stack, int& tasks)
+{
+    // A stack mesh is rebuilt whole, so it counts as one task however many of its chunks changed
+    if (ChunkStack::IsStackMeshing()) {
+        if (!stack.NeedsBuffering()) {
+            return true;
+        }
+        if (tasks >= mMaxTasksPerFrame) {
+            return false;
+        }
+        tasks++;
+        stack.BufferData();
+        return true;
+    }
+
+    for (auto& chunk : stack) {
+        if (chunk->needsBuffering) {
+            if (tasks < mMaxTasksPerFrame) {
+                tasks++;
+                chunk->BufferData();
+            }
+            else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 void World::TrySwitchToNextTextureAtlas()
 {
     double currentTime = glfwGetTime();
@@ -399,6 +483,47 @@ const ChunkStack* World::GetChunkStack(glm::ivec2 pos) const
     return &find->second;
 }
 
+// Stacks across the x and z faces of a stack
+static constexpr std::array<std::pair<int, glm::ivec2>, 4> STACK_NEIGHBOURS = {{
+    { POSITIVE_FACES[0], glm::ivec2(1, 0) },
+    { NEGATIVE_FACES[0], glm::ivec2(-1, 0) },
+    { POSITIVE_FACES[2], glm::ivec2(0, 1) },
+    { NEGATIVE_FACES[2], glm::ivec2(0, -1) }
+}};
+
+void World::LinkChunkStack(ChunkStack& stack)
+{
+    for (const auto& [face, offset] : STACK_NEIGHBOURS) {
+        auto find = mChunkStacks.find(stack.GetPosition() + offset);
+        if (find != mChunkStacks.end()) {
+            stack.LinkNeighbour(face, &find->second);
+        }
+    }
+}
+
+void World::UnlinkChunkStack(ChunkStack& stack)
+{
+    for (const auto& [face, offset] : STACK_NEIGHBOURS) {
+        stack.LinkNeighbour(face, nullptr);
+    }
+}
+
+int World::GetLodScale(int radius) const
+{
+    int scale = 1;
+    for (std::size_t level = 0; level < mLodDistances.size(); level++) {
+        if (radius >= mLodDistances[level]) {
+            scale = 2 << level;
+        }
+    }
+    return scale;
+}
+
+glm::ivec3 World::GetCameraChunkPos() const
+{
+    return GetChunkPosFromGlobalBlockPos(GetWorldBlockPosFromGlobalPos(mPlayer.camera.position));
+}
+
 std::shared_ptr<Chunk> World::GetChunk(glm::ivec3 pos) const
 {
     const ChunkStack* chunkStack = GetChunkStack(glm::ivec2( pos.x, pos.z ));
@@ -408,11 +533,48 @@ std::shared_ptr<Chunk> World::GetChunk(glm::ivec3 pos) const
     return chunkStack->GetChunk(pos[1]);
 }
 
+// Loaded chunk at an offset of at most one chunk on each axis, through the neighbour links, or null if it can't be
+// reached that way
+static Chunk* GetLinkedChunk(Chunk* chunk, glm::ivec3 offset)
+{
+    for (int axis = 0; axis < 3 && chunk != nullptr; axis++) {
+        if (std::abs(offset[axis]) > 1) {
+            return nullptr;
+        }
+        if (offset[axis] != 0) {
+            chunk = chunk->GetNeighbour(offset[axis] > 0 ? POSITIVE_FACES[axis] : NEGATIVE_FACES[axis]);
+        }
+    }
+    return chunk != nullptr && chunk->loaded ? chunk : nullptr;
+}
+
+Chunk* World::GetChunkHandle(glm::ivec3 pos) const
+{
+    const ChunkStack* chunkStack = GetChunkStack(glm::ivec2(pos.x, pos.z));
+    if (chunkStack == nullptr || chunkStack->state != ChunkStackState::LOADED) {
+        return nullptr;
+    }
+    return chunkStack->GetChunkHandle(pos.y);
+}
+
+void BlockReader::FindChunk(glm::ivec3 pos)
+{
+    glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(pos);
+    Chunk* chunk = mChunk != nullptr ? GetLinkedChunk(mChunk, chunkPos - mChunk->GetPosition()) : nullptr;
+    mChunk = chunk != nullptr ? chunk : mWorld.GetChunkHandle(chunkPos);
+    mChunkMin = chunkPos * Chunk::SIZE;
+    mHasChunk = true;
+}
+
 Block World::GetBlock(glm::ivec3 pos) const
 {
     glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(pos);
-    std::shared_ptr<Chunk> chunk = GetChunk(chunkPos);
+    Chunk* chunk = GetChunkHandle(chunkPos);
     if (chunk != nullptr) {
+        // Uniform chunks hold the same block everywhere, so skip the local position maths
+        if (chunk->IsUniform()) {
+            return chunk->RawGetBlock(glm::ivec3(0));
+        }
         glm::ivec3 blockPos = GetChunkBlockPosFromGlobalBlockPos(pos);
         return chunk->GetBlock(blockPos);
     }
@@ -421,25 +583,179 @@ Block World::GetBlock(glm::ivec3 pos) const
 
 void World::SetBlock(glm::ivec3 pos, Block block)
 {
+    // The copies are in the block's chunk and its neighbours, which are mostly reached through its links
     glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(pos);
-    std::shared_ptr<Chunk> chunk = GetChunk(chunkPos);
-
-    if (chunk != nullptr) {
-        glm::ivec3 blockPos = GetChunkBlockPosFromGlobalBlockPos(pos);
-        chunk->SetBlock(blockPos, block);
+    Chunk* blockChunk = GetChunkHandle(chunkPos);
+    for (const BlockCopy& copy : GetBlockCopies(pos)) {
+        Chunk* chunk = blockChunk != nullptr ? GetLinkedChunk(blockChunk, copy.chunkPos - chunkPos) : nullptr;
+        if (chunk == nullptr) {
+            chunk = GetChunkHandle(copy.chunkPos);
+        }
+        if (chunk != nullptr) {
+            chunk->SetBlock(copy.blockPos, block);
+        }
     }
 }
 
 void World::SetBlockAndRemesh(glm::ivec3 pos, Block block)
 {
-    glm::ivec3 chunkPos = GetChunkPosFromGlobalBlockPos(pos);
-    std::shared_ptr<Chunk> chunk = GetChunk(chunkPos);
+    SetBlock(pos, block);
+    MarkBlockDirty(pos);
+}
 
-    if (chunk != nullptr) {
-        glm::ivec3 blockPos = GetChunkBlockPosFromGlobalBlockPos(pos);
-        chunk->SetBlock(blockPos, block);
-        chunk->CreateMesh();
+void World::MarkBlockDirty(glm::ivec3 pos)
+{
+    double editTime = glfwGetTime();
+    for (const BlockCopy& copy : GetBlockCopies(pos)) {
+        if (GetChunkHandle(copy.chunkPos) == nullptr) continue;
+
+        auto [it, inserted] = mDirtyChunks.try_emplace(copy.chunkPos, DirtyChunk{ .editTime = editTime });
+        ChunkMesher::SliceMask blockSlices = ChunkMesher::GetBlockSlices(copy.blockPos.x, copy.blockPos.y, copy.blockPos.z);
+        for (int face = 0; face < 6; face++) {
+            it->second.slices[face] |= blockSlices[face];
+        }
+        mChunkEdits++;
+    }
+}
+
+void World::RemeshDirtyChunks()
+{
+    // Enclosed chunks are left unmeshed, so mesh one the camera has ended up inside, e.g. by sealing itself in
+    std::shared_ptr<Chunk> cameraChunk = GetChunk(GetCameraChunkPos());
+    if (cameraChunk != mEnclosedCameraChunk.lock()) {
+        mEnclosedCameraChunk.reset();
+    }
+    if (cameraChunk != nullptr && cameraChunk->IsEnclosed() && !cameraChunk->meshed && mEnclosedCameraChunk.expired()) {
+        QueueRemesh(cameraChunk, ChunkMesher::ALL_SLICES, glfwGetTime());
+        mEnclosedCameraChunk = cameraChunk;
+    }
+
+    for (const auto& [chunkPos, dirtyChunk] : mDirtyChunks) {
+        std::shared_ptr<Chunk> chunk = GetChunk(chunkPos);
+        if (chunk != nullptr) {
+            QueueRemesh(chunk, dirtyChunk.slices, dirtyChunk.editTime);
+            mEditRemeshes++;
+        }
+    }
+    mDirtyChunks.clear();
+}
+
+// Decode pinned blocks into a buffer of the calling thread's
+static const std::vector<Block>& DecodeSnapshot(const ChunkBlocks& snapshot)
+{
+    thread_local std::vector<Block> blocks(Chunk::SIZE_PADDED_CUBED, Block(BlockType::AIR, 0, false));
+    snapshot.storage.Decode(blocks.data());
+    return blocks;
+}
+
+void World::QueueRemesh(const std::shared_ptr<Chunk>& chunk, const ChunkMesher::SliceMask& slices, double editTime)
+{
+    // Pin the blocks as they are now, later edits on the main thread write to a copy. The job decodes them
+    ChunkBlocksSnapshot snapshot = chunk->GetBlockSnapshot();
+    uint64_t version = snapshot->version;
+    // The pending entry keeps the chunk alive, so the job never drops the last reference off the main thread
+    Chunk* target = chunk.get();
+
+    BS::thread_pool* meshPool = mParallelEditMeshing ? &mEditMeshPool : nullptr;
+
+    // Slices can only be patched into a mesh, and remeshes are buffered in order so it will be there by then.
+    // Stack meshes are rebuilt whole from the chunk meshes, so they have no slices to patch, and an enclosed chunk
+    // drops its mesh unless the camera is inside it
+    if (slices == ChunkMesher::ALL_SLICES || !chunk->meshed || ChunkStack::IsStackMeshing() || chunk->IsEnclosed()) {
+        bool meshEnclosed = chunk->GetPosition() == GetCameraChunkPos();
+        // Jobs still meshing older blocks of the chunk, for an edit or a stack loading, stop before they start
+        chunk->QueueMeshVersion(version);
+        mPendingRemeshes.push_back(PendingRemesh{
+            .chunk = chunk,
+            .meshed = mRemeshPool.submit([target, meshEnclosed, meshPool, snapshot = std::move(snapshot)] {
+                target->CreateMesh(snapshot, meshEnclosed, meshPool);
+            }),
+            .editTime = editTime,
+            .sliceMesh = nullptr,
+            .slices = slices,
+            .version = version
+        });
+        return;
+    }
+
+    auto sliceMesh = std::make_unique<ChunkMesher::ChunkMesh>();
+    ChunkMesher::ChunkMesh* mesh = sliceMesh.get();
+    mPendingRemeshes.push_back(PendingRemesh{
+        .chunk = chunk,
+        .meshed = mRemeshPool.submit([target, mesh, slices, meshPool, snapshot = std::move(snapshot)] {
+            if (target->CancelStaleMesh(snapshot->version))
+                return;
+            for (ChunkMesher::MeshStream& stream : *mesh) {
+                stream.vertices = ChunkMesher::AcquireVertexBuffer();
+            }
+            ChunkMesher::BinaryGreedyMesh(*mesh, DecodeSnapshot(*snapshot), slices, ChunkMesher::ALL_VOXEL_CLASSES, meshPool);
+        }),
+        .editTime = editTime,
+        .sliceMesh = std::move(sliceMesh),
+        .slices = slices,
+        .version = version
+    });
+}
+
+void World::BufferRemeshedChunk(const std::shared_ptr<Chunk>& chunk)
+{
+    if (!ChunkStack::IsStackMeshing()) {
         chunk->BufferData();
+        return;
+    }
+
+    // The chunk's stack may have unloaded while it was remeshing
+    glm::ivec3 chunkPos = chunk->GetPosition();
+    auto find = mChunkStacks.find(glm::ivec2(chunkPos.x, chunkPos.z));
+    if (find != mChunkStacks.end()) {
+        find->second.BufferData();
+    }
+}
+
+void World::UploadRemeshedChunks()
+{
+    // Remeshes run one at a time in edit order, so stop at the first one still in flight
+    std::vector<std::pair<std::shared_ptr<Chunk>, double>> fullRemeshes;
+    std::size_t finished = 0;
+    for (; finished < mPendingRemeshes.size(); finished++) {
+        PendingRemesh& remesh = mPendingRemeshes[finished];
+        if (remesh.meshed.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            break;
+        }
+
+        if (remesh.sliceMesh == nullptr) {
+            BufferRemeshedChunk(remesh.chunk);
+        }
+        else {
+            // A partial remesh of older blocks than a full remesh published or queued since, which covers its edits
+            remesh.superseded = remesh.superseded || remesh.chunk->IsMeshStale(remesh.version);
+            bool buffered = !remesh.superseded && remesh.chunk->BufferSlices(*remesh.sliceMesh, remesh.slices);
+            for (ChunkMesher::MeshStream& stream : *remesh.sliceMesh) {
+                ChunkMesher::ReleaseVertexBuffer(stream.vertices);
+            }
+            if (remesh.superseded) {
+                continue;
+            }
+
+            // The slices outgrew the space left in the chunk's buffers, so remesh it whole, which also covers any
+            // partial remeshes of it still queued
+            if (!buffered) {
+                for (std::size_t i = finished + 1; i < mPendingRemeshes.size(); i++) {
+                    if (mPendingRemeshes[i].chunk == remesh.chunk) {
+                        mPendingRemeshes[i].superseded = true;
+                    }
+                }
+                fullRemeshes.emplace_back(remesh.chunk, remesh.editTime);
+                continue;
+            }
+        }
+        mLastEditLatency = glfwGetTime() - remesh.editTime;
+        mMaxEditLatency = std::max(mMaxEditLatency, mLastEditLatency);
+    }
+    mPendingRemeshes.erase(mPendingRemeshes.begin(), mPendingRemeshes.begin() + finished);
+
+    for (const auto& [chunk, editTime] : fullRemeshes) {
+        QueueRemesh(chunk, ChunkMesher::ALL_SLICES, editTime);
     }
 }
 
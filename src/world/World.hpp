@@ -9,6 +9,7 @@ License: MIT
 #include <world/Skybox.hpp>
 #include <opengl/Shader.hpp>
 #include <opengl/Texture.hpp>
+#include <opengl/QuadElementBuffer.hpp>
 #include <world/chunk/ChunkStack.hpp>
 #include <world/Block.hpp>
 #include <world/Player.hpp>
@@ -18,7 +19,10 @@ License: MIT
 #include <unordered_map>
 #include <BS_thread_pool.hpp>
 #include <array>
+#include <future>
+#include <vector>
 #include <stdexcept>
+#include <thread>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -27,6 +31,7 @@ License: MIT
 glm::ivec3 GetWorldBlockPosFromGlobalPos(glm::vec3 globalPosition);
 glm::ivec3 GetChunkPosFromGlobalBlockPos(glm::ivec3 globalBlockPos);
 glm::ivec3 GetChunkBlockPosFromGlobalBlockPos(glm::ivec3 pos);
+glm::ivec3 GetGlobalBlockPosFromChunkBlockPos(glm::ivec3 chunkPos, glm::ivec3 chunkBlockPos);
 
 constexpr float GRAVITY = 0.5f;
 
@@ -46,12 +51,47 @@ class World {
 private:
     std::unordered_map<glm::ivec2, ChunkStack> mChunkStacks;
     Skybox mSkybox;
-    Shader mChunkShader = Shader("shaders/chunk.shader");
-    Shader mWaterShader = Shader("shaders/water.shader");
+    Shader mChunkShader = Shader(ChunkMesher::GetMeshFormat() == ChunkMesher::MeshFormat::QUAD_INSTANCES ? "shaders/chunk_quad.shader" : "shaders/chunk.shader");
+    Shader mWaterShader = Shader(ChunkMesher::GetMeshFormat() == ChunkMesher::MeshFormat::QUAD_INSTANCES ? "shaders/water_quad.shader" : "shaders/water.shader");
     Shader mCustomModelShader = Shader("shaders/custom_model.shader");
+    QuadElementBuffer mQuadIndices{ 1 << 16 }; // Shared by all chunk meshes
     siv::PerlinNoise mPerlin;
     BS::thread_pool mTaskPool;
     BS::thread_pool mUnloadPool;
+    // Edit remeshes spread each chunk over these threads. The task pool has no priorities, so there they would
+    // queue behind terrain generation. Declared first so it outlives the remesh thread that waits on it
+    BS::thread_pool mEditMeshPool;
+    // Player edits are meshed on their own thread so they never queue behind terrain generation
+    BS::thread_pool mRemeshPool{ 1 };
+    struct PendingRemesh {
+        std::shared_ptr<Chunk> chunk;
+        std::future<void> meshed;
+        double editTime;
+        // Only set for partial remeshes, a full remesh is published to the chunk itself
+        std::unique_ptr<ChunkMesher::ChunkMesh> sliceMesh;
+        ChunkMesher::SliceMask slices{};
+        uint64_t version; // Of the blocks meshed
+        bool superseded = false; // A full remesh queued after this one covers it
+    };
+    std::vector<PendingRemesh> mPendingRemeshes;
+    // Slices of every chunk edited since the last RemeshDirtyChunks, and when the first of those edits was made
+    struct DirtyChunk {
+        ChunkMesher::SliceMask slices{};
+        double editTime;
+    };
+    std::unordered_map<glm::ivec3, DirtyChunk> mDirtyChunks;
+    void QueueRemesh(const std::shared_ptr<Chunk>& chunk, const ChunkMesher::SliceMask& slices, double editTime);
+    std::weak_ptr<Chunk> mEnclosedCameraChunk; // Enclosed chunk the camera is in, once it has been queued for meshing
+    // Buffer the new mesh of a remeshed chunk, or the stack mesh it is part of
+    void BufferRemeshedChunk(const std::shared_ptr<Chunk>& chunk);
+    // Buffer any new meshes in a stack, returns false once the tasks for this frame have run out
+    bool BufferChunkStack(ChunkStack& stack, int& tasks);
+    // Link the chunks of a stack added to the world with those of the stacks beside it, and unlink them before it is
+    // removed
+    void LinkChunkStack(ChunkStack& stack);
+    void UnlinkChunkStack(ChunkStack& stack);
+    // Blocks per cell of the level of detail partially loaded stacks at a radius are meshed with
+    int GetLodScale(int radius) const;
     std::array<TexArray2D, MAX_ANIMATION_FRAMES> mTextureAtlases;
     Tex2D mGrassSideMask = Tex2D("textures/block/mask/grass_side_mask.png", GL_TEXTURE1);
     std::size_t mCurrentAtlasID{ 0 };
@@ -74,7 +114,11 @@ public:
     glm::vec3 mGrassColor = glm::vec3( 145.0f, 189.0f, 89.0f ) / 255.0f;
     int mChunkLoadDistance = 3;
     int mChunkPartialLoadDistance = 1;
+    // Radius from which partially loaded stacks are meshed with cells of 2, 4 and 8 blocks
+    std::array<int, 3> mLodDistances = { 8, 12, 16 };
     int mMaxTasksPerFrame = 20;
+    // Split the meshing of each edited chunk over several threads to make edits visible sooner
+    bool mParallelEditMeshing = std::thread::hardware_concurrency() > 1;
     Player mPlayer;
     void Draw(const Frustum& frustum, int* totalChunks, int* chunksDrawn);
     void TrySwitchToNextTextureAtlas();
@@ -84,9 +128,58 @@ public:
     double mCurrentTime; // Current world time
     const ChunkStack* GetChunkStack(glm::ivec2 pos) const;
     std::shared_ptr<Chunk> GetChunk(glm::ivec3 pos) const;
+    // Non-owning chunk pointer without the reference counting of GetChunk. Stacks only unload on the main thread in
+    // Update, so it stays valid for the rest of the frame, or for a job the main thread waits on
+    Chunk* GetChunkHandle(glm::ivec3 pos) const;
+    glm::ivec3 GetCameraChunkPos() const;
     Block GetBlock(glm::ivec3 pos) const;
+    // Set a block, including its copies in the padding of neighbouring chunks
     void SetBlock(glm::ivec3 pos, Block block);
     void SetBlockAndRemesh(glm::ivec3 pos, Block block);
+    // Mark the chunks holding a block, including in their padding, to be remeshed by the next RemeshDirtyChunks
+    void MarkBlockDirty(glm::ivec3 pos);
+    // Queue one remesh for every chunk edited since the last call, covering all of its edits. Called once per frame,
+    // the old meshes keep drawing until UploadRemeshedChunks swaps the new ones in
+    void RemeshDirtyChunks();
+    // Buffer every finished edit remesh, must be called from the main thread
+    void UploadRemeshedChunks();
+    double mLastEditLatency = 0.0; // Seconds between the last edit and its mesh becoming visible
+    double mMaxEditLatency = 0.0;
+    std::size_t mChunkEdits = 0; // Edits of a chunk, each of which used to remesh it
+    std::size_t mEditRemeshes = 0; // Remeshes the edits were coalesced into
+    std::size_t mStackMeshQuads = 0; // Quads in the loaded stack meshes when stack meshing
+    std::size_t mChunkMeshQuads = 0; // Quads the same chunks have when meshed one at a time
+    std::size_t mEnclosedChunksSkipped = 0; // Chunks left out of frustum culling and drawing last frame as enclosed
+};
+
+// Reads blocks of the world for runs of nearby queries, such as collision boxes and raycasts, remembering the chunk
+// of the last block read so the next block in it needs no lookup. Holds chunk handles, so it is only valid for as
+// long as they are
+class BlockReader {
+private:
+    const World& mWorld;
+    Chunk* mChunk = nullptr; // Null for an unloaded chunk, which reads as air
+    glm::ivec3 mChunkMin{}; // World position of the first block inside the remembered chunk
+    bool mHasChunk = false;
+    void FindChunk(glm::ivec3 pos);
+public:
+    explicit BlockReader(const World& world) : mWorld(world) {}
+    Block GetBlock(glm::ivec3 pos)
+    {
+        // Per component, glm's vector arithmetic on ivec3 doesn't reduce to plain registers
+        int x = pos.x - mChunkMin.x;
+        int y = pos.y - mChunkMin.y;
+        int z = pos.z - mChunkMin.z;
+        if (!mHasChunk || static_cast<unsigned>(x) >= Chunk::SIZE || static_cast<unsigned>(y) >= Chunk::SIZE || static_cast<unsigned>(z) >= Chunk::SIZE) {
+            FindChunk(pos);
+            x = pos.x - mChunkMin.x;
+            y = pos.y - mChunkMin.y;
+            z = pos.z - mChunkMin.z;
+        }
+        return mChunk != nullptr ? mChunk->GetBlock(glm::ivec3(x + 1, y + 1, z + 1)) : Block(BlockType::AIR, 0, false);
+    }
+    // Chunk of the last block read, null if it is not loaded
+    Chunk* GetChunk() const { return mChunk; }
 };
 
 #endif // !WORLD_H
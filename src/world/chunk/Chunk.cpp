@@ -14,15 +14,41 @@ std::size_t VoxelIndex(glm::ivec3 pos) {
     return pos.y + (pos.x << Chunk::SIZE_PADDED_LOG_2) + (pos.z << Chunk::SIZE_PADDED_SQUARED_LOG_2);
 }
 
-Chunk::Chunk(glm::ivec3 pos) : mPos(pos)
+static VertexBufferLayout BuildGreedyQuadLayout()
+{
+    VertexBufferLayout layout;
+    layout.AddAttribute<unsigned int>(2);
+    // Greedy meshed quads are read once per instance in the quad instance format
+    if (ChunkMesher::GetMeshFormat() == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        layout.SetDivisor(1);
+    }
+    return layout;
+}
+
+// Built on first use, after the mesh format has been chosen
+const VertexBufferLayout& GetGreedyQuadLayout()
+{
+    static const VertexBufferLayout layout = BuildGreedyQuadLayout();
+    return layout;
+}
+
+// Blocks of a chunk of air
+static std::shared_ptr<ChunkBlocks> MakeAirBlocks()
+{
+    auto blocks = std::make_shared<ChunkBlocks>(Chunk::SIZE_PADDED_CUBED);
+    blocks->histogram.Add(Block(BlockType::AIR, 0, false), Chunk::SIZE * Chunk::SIZE * Chunk::SIZE);
+    return blocks;
+}
+
+Chunk::Chunk(glm::ivec3 pos) : mBlocks(MakeAirBlocks()), mPos(pos)
 {
     // Setup buffers
     VertexBufferLayout bufferLayout;
     bufferLayout.AddAttribute<unsigned int>(2);
 
-    mVAO.AddBuffer(mVBO, bufferLayout);
-    mWaterVAO.AddBuffer(mWaterVBO, bufferLayout);
-    mCustomModelVAO.AddBuffer(mCustomModelVBO, bufferLayout);
+    mVAO.AddBuffer(mVBO.GetBuffer(), GetGreedyQuadLayout());
+    mWaterVAO.AddBuffer(mWaterVBO.GetBuffer(), GetGreedyQuadLayout());
+    mCustomModelVAO.AddBuffer(mCustomModelVBO.GetBuffer(), bufferLayout);
 
     // Transform it to its global position
     glm::vec3 globalPosition = static_cast<glm::vec3>(pos * Chunk::SIZE);
@@ -40,121 +66,513 @@ glm::ivec3 Chunk::GetPosition() const
     return mPos;
 }
 
+static std::atomic<std::size_t> sBlockSnapshotCopies = 0;
+
+std::size_t GetBlockSnapshotCopies()
+{
+    return sBlockSnapshotCopies;
+}
+
 void Chunk::AllocateMemory()
 {
-    mBlocks.resize(Chunk::SIZE_PADDED_CUBED, Block(BlockType::AIR, 0, false));
+    ReplaceBlocks(MakeAirBlocks());
+    ClearSealedCells();
     allocated = true;
 }
 
 void Chunk::ReleaseMemory()
 {
-    decltype(mBlocks)().swap(mBlocks);
+    ReplaceBlocks(MakeAirBlocks());
+    ClearSealedCells();
     allocated = false;
 }
 
+ChunkBlocksSnapshot Chunk::GetBlockSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(mBlocksMutex);
+    return mBlocks;
+}
+
+ChunkBlocks& Chunk::GetWritableBlocks()
+{
+    // References are only added by pinning, under the lock held here, so blocks with no other reference stay that
+    // way for the rest of the write
+    if (mBlocks.use_count() > 1) {
+        mBlocks = std::make_shared<ChunkBlocks>(*mBlocks);
+        sBlockSnapshotCopies++;
+    }
+    else {
+        // Pairs with the release of the last job's reference, so that job's reads happen before this write
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *mBlocks;
+}
+
+void Chunk::ReplaceBlocks(std::shared_ptr<ChunkBlocks> blocks)
+{
+    std::lock_guard<std::mutex> lock(mBlocksMutex);
+    blocks->version = mBlocks->version + 1;
+    mBlocks.swap(blocks);
+}
+
+// Blocks that hide everything behind them
+static bool IsOpaqueCube(Block block)
+{
+    const BlockDataStruct& blockData = GetBlockData(block.GetType());
+    return blockData.opaque && blockData.modelID == static_cast<ModelID>(Model::CUBE);
+}
+
+bool Chunk::IsWorldFloor(int face) const
+{
+    return face == NEGATIVE_FACES[1] && mPos.y == 0;
+}
+
+void Chunk::UpdateSealedCell(glm::ivec3 pos)
+{
+    // A block can be on the boundary of up to three faces, on one side or the other
+    for (int axis = 0; axis < 3; axis++) {
+        int face;
+        glm::ivec3 inner = pos;
+        glm::ivec3 outer = pos;
+        if (pos[axis] <= 1) {
+            face = NEGATIVE_FACES[axis];
+            inner[axis] = 1;
+            outer[axis] = 0;
+        }
+        else if (pos[axis] >= SIZE) {
+            face = POSITIVE_FACES[axis];
+            inner[axis] = SIZE;
+            outer[axis] = SIZE_PADDED_SUB_1;
+        }
+        else {
+            continue;
+        }
+
+        int bit = pos[(axis + 1) % 3];
+        int row = pos[(axis + 2) % 3];
+        if (bit < 1 || bit > SIZE || row < 1 || row > SIZE) continue;
+
+        uint64_t mask = 1ULL << bit;
+        bool wasSealed = (mSealedCells[face][row] & mask) != 0;
+        bool sealed = IsOpaqueCube(mBlocks->storage.Get(VoxelIndex(inner))) && (IsWorldFloor(face) || IsOpaqueCube(mBlocks->storage.Get(VoxelIndex(outer))));
+        if (sealed == wasSealed) continue;
+
+        mSealedCells[face][row] ^= mask;
+        mSealedCellCounts[face] += sealed ? 1 : -1;
+        if (mSealedCellCounts[face] == SIZE * SIZE) {
+            mSealedFaces |= static_cast<uint8_t>(1 << face);
+        }
+        else {
+            mSealedFaces &= static_cast<uint8_t>(~(1 << face));
+        }
+    }
+}
+
+void Chunk::RebuildSealedCells(const Block* blocks)
+{
+    uint8_t sealedFaces = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            int face = side == 0 ? NEGATIVE_FACES[axis] : POSITIVE_FACES[axis];
+            mSealedCells[face].fill(0);
+            mSealedCellCounts[face] = 0;
+            for (int row = 1; row <= SIZE; row++) {
+                for (int bit = 1; bit <= SIZE; bit++) {
+                    glm::ivec3 inner;
+                    inner[axis] = side == 0 ? 1 : SIZE;
+                    inner[(axis + 1) % 3] = bit;
+                    inner[(axis + 2) % 3] = row;
+                    glm::ivec3 outer = inner;
+                    outer[axis] = side == 0 ? 0 : SIZE_PADDED_SUB_1;
+                    if (IsOpaqueCube(blocks[VoxelIndex(inner)]) && (IsWorldFloor(face) || IsOpaqueCube(blocks[VoxelIndex(outer)]))) {
+                        mSealedCells[face][row] |= 1ULL << bit;
+                        mSealedCellCounts[face]++;
+                    }
+                }
+            }
+            if (mSealedCellCounts[face] == SIZE * SIZE) {
+                sealedFaces |= static_cast<uint8_t>(1 << face);
+            }
+        }
+    }
+    mSealedFaces = sealedFaces;
+}
+
+void Chunk::ClearSealedCells()
+{
+    for (std::array<uint64_t, 64>& rows : mSealedCells) {
+        rows.fill(0);
+    }
+    mSealedCellCounts.fill(0);
+    mSealedFaces = 0;
+}
+
+bool Chunk::IsInside(glm::ivec3 pos)
+{
+    return pos.x >= 1 && pos.x <= SIZE && pos.y >= 1 && pos.y <= SIZE && pos.z >= 1 && pos.z <= SIZE;
+}
+
+void Chunk::WriteBlock(glm::ivec3 pos, Block block)
+{
+    std::lock_guard<std::mutex> lock(mBlocksMutex);
+    ChunkBlocks& blocks = GetWritableBlocks();
+    std::size_t index = VoxelIndex(pos);
+    if (IsInside(pos)) {
+        blocks.histogram.Add(blocks.storage.Get(index), -1);
+        blocks.histogram.Add(block);
+    }
+    blocks.storage.Set(index, block);
+    blocks.version++;
+}
+
+void Chunk::RebuildBlockHistogram(BlockHistogram& histogram, const Block* blocks)
+{
+    histogram = BlockHistogram{};
+    for (int z = 1; z <= SIZE; z++) {
+        for (int x = 1; x <= SIZE; x++) {
+            const Block* column = &blocks[VoxelIndex(glm::ivec3(x, 0, z))];
+            for (int y = 1; y <= SIZE; y++) {
+                histogram.Add(column[y]);
+            }
+        }
+    }
+}
+
+const BlockHistogram& Chunk::GetBlockHistogram() const
+{
+    return mBlocks->histogram;
+}
+
+// Whether blocks with these voxel classes make any faces. Opacity alone doesn't, it only culls and shades
+static bool HasMeshedClasses(uint32_t chunkClasses)
+{
+    return (chunkClasses & ~(1u << ChunkMesher::SOLID_CLASS)) != 0;
+}
+
+bool Chunk::IsEnclosed() const
+{
+    return mSealedFaces == 0b111111;
+}
+
 void Chunk::CreateMesh() {
-    // Erase previous data!
-    std::vector<ChunkMesher::ChunkVertex>().swap(mVertices);
-    mVertexCount = 0;
+    CreateMesh(GetBlockSnapshot());
+}
 
-    std::vector<ChunkMesher::ChunkVertex>().swap(mWaterVertices);
-    mWaterVertexCount = 0;
+void Chunk::CreateMesh(const ChunkBlocksSnapshot& snapshot, bool meshEnclosed, BS::thread_pool* pool) {
+    if (CancelStaleMesh(snapshot->version))
+        return;
 
-    std::vector<ChunkMesher::ChunkVertex>().swap(mCustomModelVertices);
-    mCustomModelVertexCount = 0;
+    // Nothing in an enclosed chunk can be seen from outside it
+    if (!meshEnclosed && IsEnclosed()) {
+        ChunkMesher::ChunkMesh mesh;
+        PublishMesh(mesh, snapshot->version, false);
+        return;
+    }
+
+    // A uniform chunk of cubes has every face culled by an identical neighbour (the padding is uniform
+    // too), and a chunk of air has no faces whatever its padding, so there is nothing to mesh and no need
+    // to materialise the blocks
+    uint32_t chunkClasses = ChunkMesher::GetHistogramClasses(snapshot->histogram);
+    if ((snapshot->storage.IsUniform() && GetBlockData(snapshot->storage.Get(0).GetType()).modelID == static_cast<ModelID>(Model::CUBE)) || !HasMeshedClasses(chunkClasses)) {
+        ChunkMesher::ChunkMesh mesh;
+        PublishMesh(mesh, snapshot->version);
+        return;
+    }
 
-    // Mesh
-    ChunkMesher::BinaryGreedyMesh(mVertices, mBlocks, ChunkMesher::IsOpaqueCube);
-    ChunkMesher::BinaryGreedyMesh(mVertices, mBlocks, [](Block block) { return block.GetType() == BlockType::GLASS; });
-    ChunkMesher::BinaryGreedyMesh(mWaterVertices, mBlocks, [](Block block) { return block.GetType() == BlockType::WATER || block.IsWaterLogged(); });
-    ChunkMesher::MeshCustomModelBlocks(mCustomModelVertices, mBlocks);
-    needsBuffering = true;
+    // Decode palette into a dense per thread buffer for the mesher
+    thread_local std::vector<Block> blocks(Chunk::SIZE_PADDED_CUBED, Block(BlockType::AIR, 0, false));
+    snapshot->storage.Decode(blocks.data());
+
+    // Mesh into recycled buffers, the mesh currently on the GPU keeps drawing until this one is buffered
+    ChunkMesher::ChunkMesh mesh;
+    for (ChunkMesher::MeshStream& stream : mesh) {
+        stream.vertices = ChunkMesher::AcquireVertexBuffer();
+    }
+    ChunkMesher::BinaryGreedyMesh(mesh, blocks, ChunkMesher::ALL_SLICES, chunkClasses, pool);
+    PublishMesh(mesh, snapshot->version);
 }
 
-void Chunk::BufferData()
+void Chunk::CreateLodMesh(int scale) {
+    ChunkBlocksSnapshot snapshot = GetBlockSnapshot();
+    if (CancelStaleMesh(snapshot->version))
+        return;
+
+    uint32_t chunkClasses = ChunkMesher::GetHistogramClasses(snapshot->histogram);
+    if (IsEnclosed() || !HasMeshedClasses(chunkClasses)) {
+        ChunkMesher::ChunkMesh mesh;
+        PublishMesh(mesh, snapshot->version, false);
+        return;
+    }
+
+    thread_local std::vector<Block> blocks(Chunk::SIZE_PADDED_CUBED, Block(BlockType::AIR, 0, false));
+    thread_local std::vector<Block> lodBlocks(Chunk::SIZE_PADDED_CUBED, Block(BlockType::AIR, 0, false));
+    snapshot->storage.Decode(blocks.data());
+    ChunkMesher::DownsampleBlocks(blocks, scale, lodBlocks);
+
+    ChunkMesher::ChunkMesh mesh;
+    for (ChunkMesher::MeshStream& stream : mesh) {
+        stream.vertices = ChunkMesher::AcquireVertexBuffer();
+    }
+    ChunkMesher::BinaryGreedyMesh(mesh, lodBlocks);
+    PublishMesh(mesh, snapshot->version, false);
+}
+
+static std::atomic<std::size_t> sCancelledMeshes = 0;
+static std::atomic<std::size_t> sDiscardedMeshes = 0;
+
+StaleMeshStats GetStaleMeshStats()
+{
+    return { sCancelledMeshes, sDiscardedMeshes };
+}
+
+void Chunk::QueueMeshVersion(uint64_t version)
 {
-    if (mVertices.size() > 0) {
-        mVBO.BufferData(mVertices.data(), mVertices.size() * sizeof(ChunkMesher::ChunkVertex), GL_STATIC_DRAW);
-        mVertexCount = mVertices.size();
+    // Only queued from the main thread
+    if (version > mQueuedMeshVersion) {
+        mQueuedMeshVersion = version;
     }
-    std::vector<ChunkMesher::ChunkVertex>().swap(mVertices);
+}
 
-    if (mWaterVertices.size() > 0) {
-        mWaterVBO.BufferData(mWaterVertices.data(), mWaterVertices.size() * sizeof(ChunkMesher::ChunkVertex), GL_STATIC_DRAW);
-        mWaterVertexCount = mWaterVertices.size();
+bool Chunk::IsMeshStale(uint64_t version) const
+{
+    return version < mMeshVersion || version < mQueuedMeshVersion;
+}
+
+bool Chunk::CancelStaleMesh(uint64_t version) const
+{
+    if (!IsMeshStale(version))
+        return false;
+    sCancelledMeshes++;
+    return true;
+}
+
+void Chunk::PublishMesh(ChunkMesher::ChunkMesh& mesh, uint64_t version, bool complete)
+{
+    // Swap the new mesh in as a whole, a newer mesh replaces one that was never buffered. A mesh older than one
+    // published or queued since is dropped, while a mesh of the same blocks is still taken, it may differ in what it
+    // leaves out (an enclosed chunk the camera is now inside)
+    {
+        std::lock_guard<std::mutex> lock(mMeshMutex);
+        if (IsMeshStale(version)) {
+            sDiscardedMeshes++;
+        }
+        else {
+            std::swap(mMesh, mesh);
+            mMeshVersion = version;
+            needsBuffering = true;
+            meshed = complete;
+        }
+    }
+    for (ChunkMesher::MeshStream& stream : mesh) {
+        ChunkMesher::ReleaseVertexBuffer(stream.vertices);
     }
-    std::vector<ChunkMesher::ChunkVertex>().swap(mWaterVertices);
+}
 
-    if (mCustomModelVertices.size() > 0) {
-        mCustomModelVBO.BufferData(mCustomModelVertices.data(), mCustomModelVertices.size() * sizeof(ChunkMesher::ChunkVertex), GL_STATIC_DRAW);
-        mCustomModelVertexCount = mCustomModelVertices.size();
+std::array<SlicedVertexBuffer*, ChunkMesher::NUM_MESH_STREAMS> Chunk::GetStreamBuffers()
+{
+    return { &mVBO, &mWaterVBO, &mCustomModelVBO };
+}
+
+void Chunk::BufferData()
+{
+    std::lock_guard<std::mutex> lock(mMeshMutex);
+    if (!needsBuffering)
+        return;
+
+    std::array<SlicedVertexBuffer*, ChunkMesher::NUM_MESH_STREAMS> buffers = GetStreamBuffers();
+    for (int stream = 0; stream < ChunkMesher::NUM_MESH_STREAMS; stream++) {
+        buffers[stream]->Upload(mMesh[stream]);
+        ChunkMesher::ReleaseVertexBuffer(mMesh[stream].vertices);
     }
-    std::vector<ChunkMesher::ChunkVertex>().swap(mCustomModelVertices);
 
     needsBuffering = false;
 }
 
-void Chunk::UpdateVisiblity(const Frustum& frustum)
+bool Chunk::TakeMesh(ChunkMesher::ChunkMesh& mesh)
+{
+    std::lock_guard<std::mutex> lock(mMeshMutex);
+    if (!needsBuffering)
+        return false;
+
+    std::swap(mMesh, mesh);
+    for (ChunkMesher::MeshStream& stream : mMesh) {
+        ChunkMesher::ReleaseVertexBuffer(stream.vertices);
+    }
+    needsBuffering = false;
+    return true;
+}
+
+bool Chunk::BufferSlices(const ChunkMesher::ChunkMesh& mesh, const ChunkMesher::SliceMask& slices)
 {
-    visible = (mVertexCount > 0 && mWaterVertexCount > 0 && mCustomModelVertexCount > 0) || sphere.IsOnFrustum(frustum);
+    // A full mesh still waiting to be buffered was made before the slices, so it has to go first
+    BufferData();
+
+    std::lock_guard<std::mutex> lock(mMeshMutex);
+    if (!meshed)
+        return false;
+
+    // Either every stream takes its slices or none do, so the streams never show different edits
+    std::array<SlicedVertexBuffer*, ChunkMesher::NUM_MESH_STREAMS> buffers = GetStreamBuffers();
+    for (int stream = 0; stream < ChunkMesher::NUM_MESH_STREAMS; stream++) {
+        if (!buffers[stream]->CanUploadSlices(mesh[stream], slices))
+            return false;
+    }
+    for (int stream = 0; stream < ChunkMesher::NUM_MESH_STREAMS; stream++) {
+        buffers[stream]->UploadSlices(mesh[stream], slices);
+    }
+    return true;
 }
 
-void Chunk::Draw(Shader& shader, int* potentialDrawCalls, int* totalDrawCalls)
+void Chunk::UpdateVisiblity(const Frustum& frustum, glm::vec3 cameraPos)
+{
+    visible = (mVBO.GetVertexCount() > 0 && mWaterVBO.GetVertexCount() > 0 && mCustomModelVBO.GetVertexCount() > 0) || sphere.IsOnFrustum(frustum);
+    glm::vec3 boxMin = static_cast<glm::vec3>(mPos * Chunk::SIZE);
+    mCameraFacingFaces = GetCameraFacingFaces(boxMin, boxMin + glm::vec3(static_cast<float>(Chunk::SIZE)), cameraPos);
+}
+
+uint8_t GetCameraFacingFaces(glm::vec3 boxMin, glm::vec3 boxMax, glm::vec3 cameraPos)
+{
+    // A face is only front facing when the camera is on its outward side, which for a face anywhere in the box
+    // needs the camera past the box's far side from the face
+    constexpr int axis_faces[3][2] = { { 2, 3 }, { 4, 5 }, { 0, 1 } }; // Positive and negative face of x, y and z
+    uint8_t faces = ALL_FACES;
+    for (int axis = 0; axis < 3; axis++) {
+        if (cameraPos[axis] <= boxMin[axis]) faces &= static_cast<uint8_t>(~(1 << axis_faces[axis][0]));
+        if (cameraPos[axis] >= boxMax[axis]) faces &= static_cast<uint8_t>(~(1 << axis_faces[axis][1]));
+    }
+    return faces;
+}
+
+// Only drawn from the main thread
+static std::vector<SlicedVertexBuffer::Range> sDrawRanges;
+static std::vector<QuadElementBuffer::QuadRange> sQuadRanges;
+static GreedyDrawStats sGreedyDrawStats{};
+
+void DrawGreedyQuads(VertexArray& vao, const SlicedVertexBuffer& vbo, QuadElementBuffer& quadIndices, uint8_t faces)
+{
+    bool quadInstances = ChunkMesher::GetMeshFormat() == ChunkMesher::MeshFormat::QUAD_INSTANCES;
+    std::size_t quadVertices = quadInstances ? 1 : QuadElementBuffer::VERTICES_PER_QUAD;
+    std::size_t drawn = vbo.GetFaceVertexCount(faces);
+    sGreedyDrawStats.drawn += drawn / quadVertices;
+    sGreedyDrawStats.culled += vbo.GetFaceVertexCount(ALL_FACES & ~faces) / quadVertices;
+    if (drawn == 0) return;
+
+    vbo.GetFaceRanges(faces, sDrawRanges);
+    if (quadInstances) {
+        for (const SlicedVertexBuffer::Range& range : sDrawRanges) {
+            vao.AddBuffer(vbo.GetBuffer(), GetGreedyQuadLayout(), range.offset * sizeof(ChunkMesher::ChunkVertex));
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(range.size));
+        }
+    }
+    else {
+        vao.Bind();
+        sQuadRanges.clear();
+        for (const SlicedVertexBuffer::Range& range : sDrawRanges) {
+            sQuadRanges.push_back(QuadElementBuffer::QuadRange{ range.offset / quadVertices, range.size / quadVertices });
+        }
+        quadIndices.Draw(sQuadRanges);
+    }
+}
+
+GreedyDrawStats GetGreedyDrawStats()
+{
+    return sGreedyDrawStats;
+}
+
+void ResetGreedyDrawStats()
+{
+    sGreedyDrawStats = GreedyDrawStats{};
+}
+
+void Chunk::Draw(Shader& shader, QuadElementBuffer& quadIndices, int* potentialDrawCalls, int* totalDrawCalls)
 {
     if (potentialDrawCalls) (*potentialDrawCalls)++;
-    if (!visible || mVertexCount == 0) return;
+    if (!visible || mVBO.GetVertexCount() == 0) return;
     if (totalDrawCalls) (*totalDrawCalls)++;
-    mVAO.Bind();
     shader.SetMat4("model", mModel);
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(mVertexCount));
+    DrawGreedyQuads(mVAO, mVBO, quadIndices, mCameraFacingFaces);
 }
 
-void Chunk::DrawWater(Shader& shader, int* potentialDrawCalls, int* totalDrawCalls)
+void Chunk::DrawWater(Shader& shader, QuadElementBuffer& quadIndices, int* potentialDrawCalls, int* totalDrawCalls)
 {
     if (potentialDrawCalls) (*potentialDrawCalls)++;
-    if (!visible || mWaterVertexCount == 0) return;
+    if (!visible || mWaterVBO.GetVertexCount() == 0) return;
     if (totalDrawCalls) (*totalDrawCalls)++;
-    mWaterVAO.Bind();
     shader.SetMat4("model", mModel);
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(mWaterVertexCount));
+    DrawGreedyQuads(mWaterVAO, mWaterVBO, quadIndices, mCameraFacingFaces);
 }
 
-void Chunk::DrawCustomModel(Shader& shader, int* potentialDrawCalls, int* totalDrawCalls)
+void Chunk::DrawCustomModel(Shader& shader, QuadElementBuffer& quadIndices, int* potentialDrawCalls, int* totalDrawCalls)
 {
     if (potentialDrawCalls) (*potentialDrawCalls)++;
-    if (!visible || mCustomModelVertexCount == 0) return;
+    if (!visible || mCustomModelVBO.GetVertexCount() == 0) return;
     if (totalDrawCalls) (*totalDrawCalls)++;
     mCustomModelVAO.Bind();
     shader.SetMat4("model", mModel);
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(mCustomModelVertexCount));
+    quadIndices.Draw(mCustomModelVBO.GetVertexCount() / QuadElementBuffer::VERTICES_PER_QUAD);
+}
+
+bool Chunk::IsUniform() const
+{
+    return mBlocks->storage.IsUniform();
 }
 
 Block Chunk::RawGetBlock(glm::ivec3 pos) const
 {
-    return mBlocks[VoxelIndex(pos)];
+    return mBlocks->storage.Get(VoxelIndex(pos));
 }
 
 void Chunk::RawSetBlock(glm::ivec3 pos, Block block)
 {
-    mBlocks[VoxelIndex(pos)] = block;
+    WriteBlock(pos, block);
+    UpdateSealedCell(pos);
     needsSaving = true;
 }
 
 Block Chunk::GetBlock(glm::ivec3 pos) const
 {
     if (!allocated || pos.x < 0 || pos.x >= SIZE_PADDED || pos.y < 0 || pos.y >= SIZE_PADDED || pos.z < 0 || pos.z >= SIZE_PADDED) return Block(BlockType::AIR, 0, false);
-    return mBlocks[VoxelIndex(pos)];
+    return mBlocks->storage.Get(VoxelIndex(pos));
 }
 
 void Chunk::SetBlock(glm::ivec3 pos, Block block)
 {
     if (!allocated || pos.x < 0 || pos.x >= SIZE_PADDED || pos.y < 0 || pos.y >= SIZE_PADDED || pos.z < 0 || pos.z >= SIZE_PADDED) return;
-    mBlocks[VoxelIndex(pos)] = block;
+    WriteBlock(pos, block);
+    UpdateSealedCell(pos);
     needsSaving = true;
 }
 
-Block* Chunk::GetBlockDataPointer() {
-    return mBlocks.data();
+Chunk* Chunk::GetNeighbour(int face) const
+{
+    return mNeighbours[face];
+}
+
+Chunk* Chunk::GetLoadedNeighbour(int face) const
+{
+    Chunk* neighbour = mNeighbours[face];
+    return neighbour != nullptr && neighbour->loaded ? neighbour : nullptr;
+}
+
+void Chunk::SetNeighbour(int face, Chunk* neighbour)
+{
+    mNeighbours[face] = neighbour;
+}
+
+void Chunk::DecodeBlocks(Block* out) const
+{
+    GetBlockSnapshot()->storage.Decode(out);
+}
+
+void Chunk::EncodeBlocks(const Block* blocks)
+{
+    // Encoded aside and swapped in whole, so a job never has to wait for it
+    auto encoded = std::make_shared<ChunkBlocks>(SIZE_PADDED_CUBED);
+    encoded->storage.Encode(blocks);
+    RebuildBlockHistogram(encoded->histogram, blocks);
+    ReplaceBlocks(std::move(encoded));
+    RebuildSealedCells(blocks);
+    allocated = true;
 }
 
 /*
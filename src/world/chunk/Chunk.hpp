@@ -9,39 +9,124 @@ License: MIT
 #include <cstdint>
 #include <opengl/VertexArray.hpp>
 #include <opengl/BufferObject.hpp>
+#include <opengl/QuadElementBuffer.hpp>
 #include <opengl/Shader.hpp>
 #include <world/chunk/ChunkMesher.hpp>
+#include <world/chunk/SlicedVertexBuffer.hpp>
+#include <world/chunk/PalettedBlockStorage.hpp>
 #include <world/Block.hpp>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <math/Frustum.hpp>
 #include <PerlinNoise.hpp>
+#include <array>
 #include <vector>
 #include <atomic>
+#include <memory>
+#include <mutex>
 
 std::size_t VoxelIndex(glm::ivec3 pos);
 
+// Layout of the greedy mesh buffers, advanced once per instance in the quad instance format
+const VertexBufferLayout& GetGreedyQuadLayout();
+
+constexpr uint8_t ALL_FACES = 0b111111;
+
+// Mesher faces on the negative and positive side of each axis
+constexpr int NEGATIVE_FACES[3] = { 3, 5, 1 };
+constexpr int POSITIVE_FACES[3] = { 2, 4, 0 };
+
+// Faces, as a mask, that can face a camera at cameraPos from somewhere in a box
+uint8_t GetCameraFacingFaces(glm::vec3 boxMin, glm::vec3 boxMax, glm::vec3 cameraPos);
+
+// Draw the faces in a mask of a greedy mesh, made of either quad instances or 4 vertices per quad. The mesh
+// is laid out by face, so each face is a range or two of the buffer
+void DrawGreedyQuads(VertexArray& vao, const SlicedVertexBuffer& vbo, QuadElementBuffer& quadIndices, uint8_t faces);
+
+// Greedy quads drawn since the last reset, and those left out as facing away from the camera
+struct GreedyDrawStats {
+    std::size_t drawn;
+    std::size_t culled;
+};
+
+GreedyDrawStats GetGreedyDrawStats();
+void ResetGreedyDrawStats();
+
+// The blocks of a chunk at one point in time, with the histogram of those inside it. A job reading a chunk away from
+// the thread writing it pins a snapshot, which never changes after that: the next write copies the blocks first
+struct ChunkBlocks {
+    PalettedBlockStorage storage;
+    BlockHistogram histogram; // Blocks inside the chunk, not counting its padding
+    uint64_t version = 0; // Goes up with every change to the chunk's blocks, so meshes can tell which is newer
+    explicit ChunkBlocks(std::size_t size) : storage(size) {}
+};
+
+using ChunkBlocksSnapshot = std::shared_ptr<const ChunkBlocks>;
+
+// Writes that had to copy a chunk's blocks because a job had them pinned
+std::size_t GetBlockSnapshotCopies();
+
+struct StaleMeshStats {
+    std::size_t cancelled; // Mesh jobs dropped before meshing, a newer mesh of the chunk was already published or queued
+    std::size_t discarded; // Meshes dropped when published, a newer mesh of the chunk was published or queued meanwhile
+};
+
+StaleMeshStats GetStaleMeshStats();
+
 class Chunk {
 private:
     VertexArray mVAO;
-    VertexBuffer mVBO;
-    std::vector<ChunkMesher::ChunkVertex> mVertices;
-    std::size_t mVertexCount = 0;
+    SlicedVertexBuffer mVBO;
 
     VertexArray mWaterVAO;
-    VertexBuffer mWaterVBO;
-    std::vector<ChunkMesher::ChunkVertex> mWaterVertices;
-    std::size_t mWaterVertexCount = 0;
+    SlicedVertexBuffer mWaterVBO;
 
     VertexArray mCustomModelVAO;
-    VertexBuffer mCustomModelVBO;
-    std::vector<ChunkMesher::ChunkVertex> mCustomModelVertices;
-    std::size_t mCustomModelVertexCount = 0;
+    SlicedVertexBuffer mCustomModelVBO;
+
+    // Latest full mesh, waiting to be buffered
+    ChunkMesher::ChunkMesh mMesh;
+    // Guards the mesh and buffers between a worker publishing a mesh and the main thread buffering it
+    std::mutex mMeshMutex;
+    // Block version of the newest mesh published, whether it is waiting to be buffered or already on the GPU
+    std::atomic<uint64_t> mMeshVersion = 0;
+    // Block version of the newest full remesh queued, which will publish a mesh at least that new
+    std::atomic<uint64_t> mQueuedMeshVersion = 0;
+    // version is that of the blocks the mesh was made from, a mesh older than the newest published or queued is dropped.
+    // complete is false for a mesh slices can't be patched into, one that left out an enclosed chunk's insides or
+    // was meshed at a lower level of detail
+    void PublishMesh(ChunkMesher::ChunkMesh& mesh, uint64_t version, bool complete = true);
+    std::array<SlicedVertexBuffer*, ChunkMesher::NUM_MESH_STREAMS> GetStreamBuffers();
 
-    std::vector<Block> mBlocks;
+    // Only one thread writes a chunk at a time, which reads the blocks directly. Writes go in place unless a
+    // snapshot of the blocks is pinned
+    std::shared_ptr<ChunkBlocks> mBlocks;
+    // Orders pinning a snapshot against a write checking whether its blocks are pinned
+    mutable std::mutex mBlocksMutex;
+    // The blocks to write to, copied first if they are pinned. Called with mBlocksMutex held
+    ChunkBlocks& GetWritableBlocks();
+    // Replace the blocks as a whole, leaving any pinned snapshot of the old ones as it is
+    void ReplaceBlocks(std::shared_ptr<ChunkBlocks> blocks);
+    // Cells of each face where both sides of the boundary, the outer layer of the chunk and the padding holding its
+    // neighbour's, are opaque cubes. One row of bits per padded row, only rows and bits 1 to SIZE are used
+    std::array<std::array<uint64_t, 64>, 6> mSealedCells{};
+    std::array<int, 6> mSealedCellCounts{};
+    std::atomic<uint8_t> mSealedFaces = 0; // Faces with every cell sealed
+    // Nothing is below the world to see the floor from, so it is sealed by the chunk's own blocks alone
+    bool IsWorldFloor(int face) const;
+    void UpdateSealedCell(glm::ivec3 pos);
+    void RebuildSealedCells(const Block* blocks);
+    void ClearSealedCells();
+    static bool IsInside(glm::ivec3 pos);
+    // Set a block, keeping the histogram of the blocks up to date
+    void WriteBlock(glm::ivec3 pos, Block block);
+    static void RebuildBlockHistogram(BlockHistogram& histogram, const Block* blocks);
+    // Chunks across each face, linked while both are in the world. Linked, unlinked and followed on the main thread
+    std::array<Chunk*, 6> mNeighbours{};
     glm::ivec3 mPos{};
     glm::mat4 mModel = glm::mat4(1.0f);
     Sphere sphere;
+    uint8_t mCameraFacingFaces = ALL_FACES;
 public:
     static constexpr int SIZE_PADDED_LOG_2 = 6;
     static constexpr int SIZE_PADDED_SQUARED_LOG_2 = SIZE_PADDED_LOG_2 * 2;
@@ -56,12 +141,41 @@ public:
     void AllocateMemory();
     void ReleaseMemory();
     void CreateMesh();
+    // Mesh a snapshot of the blocks, safe to call from a worker while the old mesh draws. Nothing is meshed if a newer
+    // mesh has been published or queued since the snapshot was pinned. Enclosed chunks are left unmeshed unless
+    // meshEnclosed is set. A pool spreads the meshing of this one chunk over its threads
+    void CreateMesh(const ChunkBlocksSnapshot& snapshot, bool meshEnclosed = false, BS::thread_pool* pool = nullptr);
+    // Mesh the chunk downsampled to cells of scale blocks a side, for distant chunks that are never edited
+    void CreateLodMesh(int scale);
     void BufferData();
-    void UpdateVisiblity(const Frustum& frustum);
-    Block* GetBlockDataPointer();
-    void Draw(Shader& shader, int* potentialDrawCalls, int* totalDrawCalls);
-    void DrawWater(Shader& shader, int* potentialDrawCalls, int* totalDrawCalls);
-    void DrawCustomModel(Shader& shader, int* potentialDrawCalls, int* totalDrawCalls);
+    // Take the mesh waiting to be buffered to buffer it elsewhere, swapping in a mesh to recycle. Returns false if there is none
+    bool TakeMesh(ChunkMesher::ChunkMesh& mesh);
+    // Patch the slices of a partial mesh into the buffered mesh, returns false if the chunk needs a full remesh instead
+    bool BufferSlices(const ChunkMesher::ChunkMesh& mesh, const ChunkMesher::SliceMask& slices);
+    // Note a full remesh of the blocks at version has been queued, so jobs meshing older blocks can stop early
+    void QueueMeshVersion(uint64_t version);
+    // Whether a mesh of the blocks at version would be older than one already published or queued
+    bool IsMeshStale(uint64_t version) const;
+    // Called by a mesh job before it starts, returns true and counts the job as cancelled if its mesh would be stale
+    bool CancelStaleMesh(uint64_t version) const;
+    // Frustum cull the chunk, and find which of its faces can face the camera
+    void UpdateVisiblity(const Frustum& frustum, glm::vec3 cameraPos);
+    // Pin the blocks as they are now, safe to call from any thread. Later writes to the chunk don't change them
+    ChunkBlocksSnapshot GetBlockSnapshot() const;
+    // Decode all blocks (including padding) into a dense array of SIZE_PADDED_CUBED blocks, from a snapshot
+    void DecodeBlocks(Block* out) const;
+    // Replace all blocks (including padding) with a dense array of SIZE_PADDED_CUBED blocks
+    void EncodeBlocks(const Block* blocks);
+    void Draw(Shader& shader, QuadElementBuffer& quadIndices, int* potentialDrawCalls, int* totalDrawCalls);
+    void DrawWater(Shader& shader, QuadElementBuffer& quadIndices, int* potentialDrawCalls, int* totalDrawCalls);
+    void DrawCustomModel(Shader& shader, QuadElementBuffer& quadIndices, int* potentialDrawCalls, int* totalDrawCalls);
+    // Whether every block in the chunk, including padding, is the same
+    bool IsUniform() const;
+    // Number of blocks of each type inside the chunk, kept up to date as blocks are set
+    const BlockHistogram& GetBlockHistogram() const;
+    // Whether all six faces of the chunk are sealed by opaque cubes on both sides, so none of its insides can be
+    // seen from outside it
+    bool IsEnclosed() const;
     // Get block in chunk - does not perform boundary checks or check whether the chunk is allocated/loaded. Dangerous!
     Block RawGetBlock(glm::ivec3 pos) const;
     // Set block in chunk - does not perform boundary checks or check whether the chunk is allocated/loaded. Dangerous!
@@ -70,9 +184,16 @@ public:
     Block GetBlock(glm::ivec3 pos) const;
     // Set block in chunk with boundary checks and allocation check
     void SetBlock(glm::ivec3 pos, Block block);
+    // Chunk across a face, null at the edge of the world's stacks or the top and bottom of a stack
+    Chunk* GetNeighbour(int face) const;
+    // Chunk across a face if it is loaded, for anything that reads or edits blocks across the border
+    Chunk* GetLoadedNeighbour(int face) const;
+    void SetNeighbour(int face, Chunk* neighbour);
     std::atomic<bool> needsBuffering = false;
+    std::atomic<bool> meshed = false; // Whether a full mesh has been created, which partial meshes are patched into
     std::atomic<bool> needsSaving = false;
     std::atomic<bool> allocated = false;
+    std::atomic<bool> loaded = false; // Whether its stack is fully loaded, so its blocks are there to read and edit
     bool visible = true;
 };
 
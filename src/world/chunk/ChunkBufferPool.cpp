@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#include <world/chunk/ChunkBufferPool.hpp>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+constexpr std::size_t SLAB_SIZE = 2 * 1024 * 1024;
+constexpr int MIN_SIZE_CLASS_LOG_2 = 12;
+constexpr int SIZE_CLASS_COUNT = 16;
+constexpr std::size_t THREAD_CACHE_SIZE = 4;
+
+struct SizeClass {
+    std::mutex mutex;
+    std::vector<void*> freeBuffers;
+};
+
+struct GlobalPool {
+    std::array<SizeClass, SIZE_CLASS_COUNT> sizeClasses;
+    std::mutex slabMutex;
+    std::vector<void*> slabs;
+    std::atomic<std::size_t> hits = 0;
+    std::atomic<std::size_t> misses = 0;
+    std::atomic<std::size_t> bytesInUse = 0;
+    std::atomic<std::size_t> highWaterMark = 0;
+    std::atomic<std::size_t> bytesReserved = 0;
+    std::atomic<bool> hugePages = true;
+
+    ~GlobalPool() {
+        for (void* slab : slabs) {
+#ifdef _MSC_VER
+            _aligned_free(slab);
+#else
+            std::free(slab);
+#endif
+        }
+    }
+};
+
+static GlobalPool& GetPool() {
+    static GlobalPool pool;
+    return pool;
+}
+
+struct ThreadCache {
+    std::array<std::array<void*, THREAD_CACHE_SIZE>, SIZE_CLASS_COUNT> buffers{};
+    std::array<std::size_t, SIZE_CLASS_COUNT> counts{};
+
+    // Hand anything left over back to the shared pool when the thread exits
+    ~ThreadCache() {
+        GlobalPool& pool = GetPool();
+        for (int sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+            std::lock_guard<std::mutex> lock(pool.sizeClasses[sizeClass].mutex);
+            for (std::size_t i = 0; i < counts[sizeClass]; i++) {
+                pool.sizeClasses[sizeClass].freeBuffers.push_back(buffers[sizeClass][i]);
+            }
+        }
+    }
+};
+
+static thread_local ThreadCache tThreadCache;
+
+static int GetSizeClass(std::size_t bytes) {
+    int sizeClassLog2 = static_cast<int>(std::bit_width(std::bit_ceil(bytes)) - 1);
+    return sizeClassLog2 < MIN_SIZE_CLASS_LOG_2 ? 0 : sizeClassLog2 - MIN_SIZE_CLASS_LOG_2;
+}
+
+static void* AllocateSlab(std::size_t bytes, bool hugePages) {
+#ifdef _MSC_VER
+    (void)hugePages;
+    void* slab = _aligned_malloc(bytes, SLAB_SIZE);
+#else
+    void* slab = std::aligned_alloc(SLAB_SIZE, bytes);
+#ifdef __linux__
+    if (slab != nullptr && hugePages) {
+        madvise(slab, bytes, MADV_HUGEPAGE);
+    }
+#else
+    (void)hugePages;
+#endif
+#endif
+    if (slab == nullptr) {
+        throw std::bad_alloc();
+    }
+    return slab;
+}
+
+// Allocate a new slab and split it into buffers for the given size class
+static void GrowSizeClass(GlobalPool& pool, int sizeClass) {
+    std::size_t bufferSize = std::size_t(1) << (sizeClass + MIN_SIZE_CLASS_LOG_2);
+    std::size_t slabSize = bufferSize > SLAB_SIZE ? bufferSize : SLAB_SIZE;
+    char* slab = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool.slabMutex);
+        slab = static_cast<char*>(AllocateSlab(slabSize, pool.hugePages));
+        pool.slabs.push_back(slab);
+    }
+    pool.bytesReserved += slabSize;
+
+    std::lock_guard<std::mutex> lock(pool.sizeClasses[sizeClass].mutex);
+    for (std::size_t offset = 0; offset < slabSize; offset += bufferSize) {
+        pool.sizeClasses[sizeClass].freeBuffers.push_back(slab + offset);
+    }
+}
+
+void* ChunkBufferPool::Allocate(std::size_t bytes)
+{
+    GlobalPool& pool = GetPool();
+    int sizeClass = GetSizeClass(bytes);
+    std::size_t bufferSize = std::size_t(1) << (sizeClass + MIN_SIZE_CLASS_LOG_2);
+
+    std::size_t inUse = pool.bytesInUse += bufferSize;
+    std::size_t highWaterMark = pool.highWaterMark;
+    while (inUse > highWaterMark && !pool.highWaterMark.compare_exchange_weak(highWaterMark, inUse)) {}
+
+    // Try this thread's cache first
+    ThreadCache& cache = tThreadCache;
+    if (cache.counts[sizeClass] > 0) {
+        pool.hits++;
+        return cache.buffers[sizeClass][--cache.counts[sizeClass]];
+    }
+
+    // Then the shared free list, growing it by a slab if it's empty
+    SizeClass& shared = pool.sizeClasses[sizeClass];
+    bool grown = false;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (!shared.freeBuffers.empty()) {
+                void* buffer = shared.freeBuffers.back();
+                shared.freeBuffers.pop_back();
+                if (!grown) pool.hits++;
+                return buffer;
+            }
+        }
+        pool.misses++;
+        grown = true;
+        GrowSizeClass(pool, sizeClass);
+    }
+}
+
+void ChunkBufferPool::Free(void* buffer, std::size_t bytes)
+{
+    if (buffer == nullptr) return;
+    GlobalPool& pool = GetPool();
+    int sizeClass = GetSizeClass(bytes);
+    pool.bytesInUse -= std::size_t(1) << (sizeClass + MIN_SIZE_CLASS_LOG_2);
+
+    ThreadCache& cache = tThreadCache;
+    if (cache.counts[sizeClass] < THREAD_CACHE_SIZE) {
+        cache.buffers[sizeClass][cache.counts[sizeClass]++] = buffer;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pool.sizeClasses[sizeClass].mutex);
+    pool.sizeClasses[sizeClass].freeBuffers.push_back(buffer);
+}
+
+ChunkBufferPool::Stats ChunkBufferPool::GetStats()
+{
+    GlobalPool& pool = GetPool();
+    return Stats{
+        .hits = pool.hits,
+        .misses = pool.misses,
+        .bytesInUse = pool.bytesInUse,
+        .highWaterMark = pool.highWaterMark,
+        .bytesReserved = pool.bytesReserved
+    };
+}
+
+void ChunkBufferPool::SetHugePagesEnabled(bool enabled)
+{
+    GetPool().hugePages = enabled;
+}
+
+bool ChunkBufferPool::IsHugePagesEnabled()
+{
+    return GetPool().hugePages;
+}
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
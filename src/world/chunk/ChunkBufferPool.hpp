@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#ifndef CHUNK_BUFFER_POOL_H
+#define CHUNK_BUFFER_POOL_H
+
+#include <cstddef>
+
+/*
+Thread safe pool recycling the fixed size buffers chunks keep their block data in. Buffers are
+rounded up to a power of two size class and carved out of 2 MB slabs which are never given back,
+so once the pool has grown to the working set, streaming chunks in and out doesn't allocate.
+Each thread keeps a small cache per size class in front of the shared free lists.
+*/
+namespace ChunkBufferPool {
+    struct Stats {
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t bytesInUse;
+        std::size_t highWaterMark;
+        std::size_t bytesReserved;
+    };
+
+    // Contents of the returned buffer are undefined
+    void* Allocate(std::size_t bytes);
+    // Size must match the one given to Allocate
+    void Free(void* buffer, std::size_t bytes);
+    Stats GetStats();
+    // Advise the kernel to back new slabs with transparent huge pages (Linux only)
+    void SetHugePagesEnabled(bool enabled);
+    bool IsHugePagesEnabled();
+};
+
+#endif // !CHUNK_BUFFER_POOL_H
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
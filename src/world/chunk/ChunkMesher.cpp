@@ -7,6 +7,29 @@ License: MIT
 #include <glm/vec2.hpp>
 #include <world/Block.hpp>
 #include <world/chunk/Chunk.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <BS_thread_pool.hpp>
+
+#ifndef NDEBUG
+#include <util/Log.hpp>
+#endif
+
+// Whole chunks are classified with AVX2 on x86-64 CPUs that support it, chosen at runtime
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAS_AVX2_CLASSIFY
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts AVX2 intrinsics in any function, so only the callers have to check the CPU supports them
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
 
 #ifdef _MSC_VER
 inline const int CTZ(uint64_t& x) {
@@ -26,8 +49,34 @@ inline const int GetAxisIndex(const int& axis, const int& a, const int& b, const
     else return c + (b * Chunk::SIZE_PADDED) + (a * Chunk::SIZE_PADDED_SQUARED);
 }
 
-inline const bool SolidCheck(BlockType blockType) {
-    return GetBlockData(blockType).opaque;
+// Voxel classes of every block type, indexed by the whole 8 bit type so no block can index out of bounds
+using VoxelClassTable = std::array<uint8_t, 256>;
+
+static VoxelClassTable BuildVoxelClassTable() {
+    VoxelClassTable table{};
+    for (std::size_t i = 0; i < static_cast<std::size_t>(BlockType::NUM_BLOCKS); i++) {
+        BlockType type = static_cast<BlockType>(i);
+        const BlockDataStruct& blockData = GetBlockData(type);
+        uint8_t classes = 0;
+        if (blockData.opaque && blockData.modelID == static_cast<ModelID>(Model::CUBE)) classes |= 1 << ChunkMesher::OPAQUE_MATERIAL;
+        if (type == BlockType::GLASS) classes |= 1 << ChunkMesher::GLASS_MATERIAL;
+        if (type == BlockType::WATER) classes |= 1 << ChunkMesher::WATER_MATERIAL;
+        if (blockData.opaque) classes |= 1 << ChunkMesher::SOLID_CLASS;
+        if (blockData.modelID != static_cast<ModelID>(Model::CUBE)) classes |= 1 << ChunkMesher::CUSTOM_MODEL_CLASS;
+        table[i] = classes;
+    }
+    return table;
+}
+
+// Built on first use, after the block data has been loaded
+static const VoxelClassTable& GetVoxelClassTable() {
+    static const VoxelClassTable table = BuildVoxelClassTable();
+    return table;
+}
+
+// A waterlogged block is meshed as water as well as its own material
+inline uint32_t GetVoxelClasses(const VoxelClassTable& table, Block block) {
+    return table[static_cast<std::size_t>(block.GetType())] | (static_cast<uint32_t>(block.IsWaterLogged()) << ChunkMesher::WATER_MATERIAL);
 }
 
 inline constexpr glm::ivec2 AODirections[8] = {
@@ -48,39 +97,48 @@ inline const int VertexAO(int side1, int side2, int corner) {
     return 3 - (side1 + side2 + corner);
 }
 
-inline const bool CompareAO(const std::vector<Block>& blocks, int axis, int forward, int right, int c, int forward_offset, int right_offset) {
-    for (const auto& ao_dir : AODirections) {
-        bool firstBlockSolid = SolidCheck(blocks.at(GetAxisIndex(axis, right + ao_dir[0], forward + ao_dir[1], c)).GetType());
-        bool secondBlockSolid = SolidCheck(blocks.at(GetAxisIndex(axis, right + right_offset + ao_dir[0], forward + forward_offset + ao_dir[1], c)).GetType());
-        if (firstBlockSolid != secondBlockSolid) {
-            return false;
-        }
-    }
-    return true;
+// Opacity of the block at (right, forward, c) from the opacity columns of one axis
+inline int IsSolid(const uint64_t* solid_cols, int right, int forward, int c) {
+    return (solid_cols[right + (forward * Chunk::SIZE_PADDED)] >> c) & 1;
 }
 
-inline const bool CompareForward(const std::vector<Block>& blocks, int axis, int forward, int right, int bit_pos, int light_dir) {
-    Block first = blocks.at(GetAxisIndex(axis, right, forward, bit_pos));
-    Block second = blocks.at(GetAxisIndex(axis, right, forward + 1, bit_pos));
-    bool ao = CompareAO(blocks, axis, forward, right, bit_pos + light_dir, 1, 0);
-    return first == second && ao;
+// Every layer where the AO neighbours of (right, forward) differ in opacity from those of the position
+// offset by (right_offset, forward_offset), as a bitmask over the layers of the column
+inline uint64_t AOMismatch(const uint64_t* solid_cols, int forward, int right, int forward_offset, int right_offset) {
+    int offset = right_offset + (forward_offset * Chunk::SIZE_PADDED);
+    uint64_t mismatch = 0;
+    for (const auto& ao_dir : AODirections) {
+        int i = right + ao_dir[0] + ((forward + ao_dir[1]) * Chunk::SIZE_PADDED);
+        mismatch |= solid_cols[i] ^ solid_cols[i + offset];
+    }
+    return mismatch;
 }
 
-inline const bool CompareRight(const std::vector<Block>& blocks, int axis, int forward, int right, int bit_pos, int light_dir) {
-    return
-        blocks.at(GetAxisIndex(axis, right, forward, bit_pos)) == blocks.at(GetAxisIndex(axis, right + 1, forward, bit_pos)) &&
-        CompareAO(blocks, axis, forward, right, bit_pos + light_dir, 0, 1);
+// Shifts a mask over the layers AO is sampled from onto the layers of the faces that sample it
+inline uint64_t AOLayerToFaceLayer(uint64_t mask, int light_dir) {
+    return light_dir > 0 ? mask >> 1 : mask << 1;
 }
 
+// Quads are drawn through the shared QuadElementBuffer as triangles (0, 1, 2) and (2, 3, 0),
+// so the diagonal the quad is split along is chosen by which corner it starts from
 inline const void InsertQuad(std::vector<ChunkMesher::ChunkVertex>& vertices, ChunkMesher::ChunkVertex v1, ChunkMesher::ChunkVertex v2, ChunkMesher::ChunkVertex v3, ChunkMesher::ChunkVertex v4, bool flipped) {
     if (flipped) {
-        vertices.insert(vertices.end(), { v3, v2, v4, v4, v2, v1 });
+        vertices.insert(vertices.end(), { v4, v3, v2, v1 });
     }
     else {
-        vertices.insert(vertices.end(), { v1, v4, v3, v3, v2, v1});
+        vertices.insert(vertices.end(), { v1, v4, v3, v2 });
     }
 }
 
+// Every quad record stores its corners in the mesher's right/forward frame so the shaders can rebuild them
+inline ChunkMesher::ChunkVertex GetChunkQuad(uint32_t left, uint32_t front, uint32_t up, uint32_t width, uint32_t height, uint32_t type, uint32_t face,
+    uint32_t ao_LF, uint32_t ao_LB, uint32_t ao_RF, uint32_t ao_RB, bool flipped, bool isGrass) {
+    return ChunkMesher::ChunkVertex{
+        (static_cast<uint32_t>(isGrass) << 31) | (static_cast<uint32_t>(flipped) << 30) | (height << 24) | (width << 18) | ((up - 1) << 12) | ((front - 1) << 6) | (left - 1),
+        (ao_RB << 17) | (ao_RF << 15) | (ao_LB << 13) | (ao_LF << 11) | (face << 8) | type,
+    };
+}
+
 inline ChunkMesher::ChunkVertex GetChunkVertex(uint32_t x, uint32_t y, uint32_t z, uint32_t ao, uint32_t texX, uint32_t texY, uint32_t type, uint32_t face, bool isGrass) {
     return ChunkMesher::ChunkVertex{
         (ao << 18) | ((z - 1) << 12) | ((y - 1) << 6) | (x - 1),
@@ -88,220 +146,1000 @@ inline ChunkMesher::ChunkVertex GetChunkVertex(uint32_t x, uint32_t y, uint32_t
     };
 }
 
-void ChunkMesher::BinaryGreedyMesh(std::vector<ChunkVertex>& vertices, const std::vector<Block>& blocks, ChunkMeshFilterCallback condition) {
-    // Step 1: Convert to binary column representation for each direction
-    std::vector<uint64_t> axis_cols(Chunk::SIZE_PADDED_SQUARED * 3);
+static ChunkMesher::MeshFormat sMeshFormat = ChunkMesher::MeshFormat::VERTICES;
+
+void ChunkMesher::SetMeshFormat(MeshFormat format) {
+    sMeshFormat = format;
+}
+
+ChunkMesher::MeshFormat ChunkMesher::GetMeshFormat() {
+    return sMeshFormat;
+}
+
+// The AVX2 kernel looks up voxel classes with a 16 entry byte shuffle, so every block type has to fit in it
+constexpr bool CLASS_TABLE_FITS_SHUFFLE = static_cast<int>(BlockType::NUM_BLOCKS) <= 16;
+
+static bool DetectAVX2() {
+#if defined(HAS_AVX2_CLASSIFY) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    // The OS has to save the wide registers across context switches as well as the CPU having them
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0b110) != 0b110) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(HAS_AVX2_CLASSIFY)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool ChunkMesher::IsSIMDClassifySupported() {
+    static const bool supported = CLASS_TABLE_FITS_SHUFFLE && DetectAVX2();
+    return supported;
+}
+
+static std::atomic<bool> sSIMDClassify = ChunkMesher::IsSIMDClassifySupported();
+
+void ChunkMesher::SetSIMDClassifyEnabled(bool enabled) {
+    sSIMDClassify = enabled && IsSIMDClassifySupported();
+}
+
+bool ChunkMesher::IsSIMDClassifyEnabled() {
+    return sSIMDClassify;
+}
+
+// Texture face of a block used by each mesher face
+inline constexpr BlockFaces MeshFaceTextures[6] = { BACK_FACE, FRONT_FACE, RIGHT_FACE, LEFT_FACE, TOP_FACE, BOTTOM_FACE };
+
+static std::atomic<std::size_t> sAllocations = 0;
+
+constexpr int AXIS_COLS_SIZE = Chunk::SIZE_PADDED_SQUARED * 3;
+// Greedy meshing is split into one task per face direction of each material, then one for the custom models
+constexpr int NUM_FACE_TASKS = ChunkMesher::NUM_MESH_MATERIALS * 6;
+constexpr int NUM_MESH_TASKS = NUM_FACE_TASKS + 1;
+
+// Temporaries of the greedy mesher, one set per thread so that meshing does not allocate once a thread has warmed up
+struct MesherScratch {
+    std::vector<uint64_t> axis_cols;
+    std::vector<uint64_t> col_face_masks; // Of the face being meshed
+    std::vector<int> merged_forward;
+    // Vertices in the order they are meshed, with the slice of each, before they are sorted into the output
+    std::array<std::vector<ChunkMesher::ChunkVertex>, ChunkMesher::NUM_MESH_STREAMS> unsorted_vertices;
+    std::array<std::vector<uint16_t>, ChunkMesher::NUM_MESH_STREAMS> vertex_slices;
+    // Output of each task when the tasks are spread over a thread pool, only grown by threads that do that
+    std::array<std::vector<ChunkMesher::ChunkVertex>, NUM_MESH_TASKS> task_vertices;
+    std::array<std::vector<uint16_t>, NUM_MESH_TASKS> task_slices;
+
+    MesherScratch() :
+        axis_cols(AXIS_COLS_SIZE * ChunkMesher::NUM_VOXEL_CLASSES),
+        col_face_masks(Chunk::SIZE_PADDED_SQUARED),
+        merged_forward(Chunk::SIZE_PADDED_SQUARED)
+    {
+        sAllocations += 3;
+    }
+};
+
+static MesherScratch& GetMesherScratch() {
+    thread_local MesherScratch scratch;
+    return scratch;
+}
+
+// Counts the heap allocation when meshing had to grow a buffer
+template <typename T>
+static void CountGrowth(const std::vector<T>& buffer, std::size_t previousCapacity) {
+    if (buffer.capacity() != previousCapacity) {
+        sAllocations++;
+    }
+}
+
+// Tags every vertex added since the last call with the slice it belongs to
+inline void TagSlice(std::vector<uint16_t>& vertex_slices, const std::vector<ChunkMesher::ChunkVertex>& vertices, int face, int layer) {
+    vertex_slices.resize(vertices.size(), static_cast<uint16_t>((face * ChunkMesher::SLICE_LAYERS) + layer));
+}
+
+// Stable counting sort of a stream's vertices by slice, which keeps the vertices of every quad together
+static void SortBySlice(ChunkMesher::MeshStream& stream, const std::vector<ChunkMesher::ChunkVertex>& vertices, const std::vector<uint16_t>& vertex_slices) {
+    ChunkMesher::SliceOffsets& offsets = stream.sliceOffsets;
+    offsets.fill(0);
+    for (uint16_t slice : vertex_slices) {
+        offsets[slice + 1]++;
+    }
+    for (int slice = 0; slice < ChunkMesher::NUM_SLICES; slice++) {
+        offsets[slice + 1] += offsets[slice];
+    }
+
+    std::array<uint32_t, ChunkMesher::NUM_SLICES> next;
+    std::copy(offsets.begin(), offsets.end() - 1, next.begin());
+    std::size_t capacity = stream.vertices.capacity();
+    stream.vertices.resize(vertices.size());
+    for (std::size_t i = 0; i < vertices.size(); i++) {
+        stream.vertices[next[vertex_slices[i]]++] = vertices[i];
+    }
+    CountGrowth(stream.vertices, capacity);
+}
+
+// Greedy merges the visible faces of one material in one face direction into quads, tagging each with its slice
+static void GreedyMeshFace(std::vector<ChunkMesher::ChunkVertex>& vertices, std::vector<uint16_t>& vertex_slices, const std::vector<Block>& blocks, const uint64_t* face_masks, const uint64_t* solid_axis_cols, std::vector<int>& merged_forward, int face) {
+    int axis = face / 2;
+    int light_dir = face % 2 == 0 ? 1 : -1;
+    const uint64_t* solid_cols = &solid_axis_cols[axis * Chunk::SIZE_PADDED_SQUARED];
+
+    std::fill(merged_forward.begin(), merged_forward.end(), 0);
+    for (int forward = 1; forward < Chunk::SIZE_PADDED - 1; forward++) {
+        uint64_t bits_walking_right = 0;
+        int merged_right[Chunk::SIZE_PADDED] = { 0 };
+        for (int right = 1; right < Chunk::SIZE_PADDED - 1; right++) {
+            uint64_t bits_here = face_masks[right + (forward * Chunk::SIZE_PADDED)];
+            uint64_t bits_forward = forward >= Chunk::SIZE ? 0 : face_masks[right + (forward * Chunk::SIZE_PADDED) + Chunk::SIZE_PADDED];
+            uint64_t bits_right = right >= Chunk::SIZE ? 0 : face_masks[right + 1 + (forward * Chunk::SIZE_PADDED)];
+            uint64_t bits_merging_forward = bits_here & bits_forward & ~bits_walking_right;
+            uint64_t bits_merging_right = bits_here & bits_right;
+
+            // Faces only merge when all of their AO neighbours match, checked for the whole column at once
+            if (bits_merging_forward) {
+                bits_merging_forward &= ~AOLayerToFaceLayer(AOMismatch(solid_cols, forward, right, 1, 0), light_dir);
+            }
+            if (bits_merging_right) {
+                bits_merging_right &= ~AOLayerToFaceLayer(AOMismatch(solid_cols, forward, right, 0, 1), light_dir);
+            }
+
+            uint64_t copy_front = bits_merging_forward;
+
+            while (copy_front) {
+                int bit_pos = CTZ(copy_front);
+                copy_front &= ~(1ULL << bit_pos);
+
+                if (bit_pos == 0 || bit_pos == Chunk::SIZE_PADDED - 1) continue;
+
+                if (blocks[GetAxisIndex(axis, right, forward, bit_pos)] == blocks[GetAxisIndex(axis, right, forward + 1, bit_pos)]) {
+                    merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos]++;
+                }
+                else {
+                    bits_merging_forward &= ~(1ULL << bit_pos);
+                }
+            }
+
+            uint64_t bits_stopped_forward = bits_here & ~bits_merging_forward;
+            while (bits_stopped_forward) {
+                int bit_pos = CTZ(bits_stopped_forward);
+                bits_stopped_forward &= ~(1ULL << bit_pos);
+
+                // Discards faces from neighbor blocks
+                if (bit_pos == 0 || bit_pos == Chunk::SIZE_PADDED - 1) { continue; };
+
+                if (
+                    (bits_merging_right & (1ULL << bit_pos)) != 0 &&
+                    merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos] == merged_forward[(right + 1) * Chunk::SIZE_PADDED + bit_pos] &&
+                    blocks[GetAxisIndex(axis, right, forward, bit_pos)] == blocks[GetAxisIndex(axis, right + 1, forward, bit_pos)])
+                {
+                    bits_walking_right |= 1ULL << bit_pos;
+                    merged_right[bit_pos]++;
+                    merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos] = 0;
+                    continue;
+                }
+                bits_walking_right &= ~(1ULL << bit_pos);
+
+                uint8_t mesh_left = right - merged_right[bit_pos];
+                uint8_t mesh_right = right + 1;
+                uint8_t mesh_front = forward - merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos];
+                uint8_t mesh_back = forward + 1;
+                uint8_t mesh_up = bit_pos + (face % 2 == 0 ? 1 : 0);
+
+                Block block = blocks[GetAxisIndex(axis, right, forward, bit_pos)];
+                BlockType type = block.IsWaterLogged() ? BlockType::WATER : block.GetType();
+                bool isGrass = type == BlockType::GRASS;
+                const BlockDataStruct& blockData = GetBlockData(type);
+
+                int c = bit_pos + light_dir;
+                int ao_F = IsSolid(solid_cols, right, forward - 1, c);
+                int ao_B = IsSolid(solid_cols, right, forward + 1, c);
+                int ao_L = IsSolid(solid_cols, right - 1, forward, c);
+                int ao_R = IsSolid(solid_cols, right + 1, forward, c);
+
+                int ao_LFC = IsSolid(solid_cols, right - 1, forward - 1, c);
+                int ao_LBC = IsSolid(solid_cols, right - 1, forward + 1, c);
+                int ao_RFC = IsSolid(solid_cols, right + 1, forward - 1, c);
+                int ao_RBC = IsSolid(solid_cols, right + 1, forward + 1, c);
+
+                uint32_t ao_LB = VertexAO(ao_L, ao_B, ao_LBC);
+                uint32_t ao_LF = VertexAO(ao_L, ao_F, ao_LFC);
+                uint32_t ao_RB = VertexAO(ao_R, ao_B, ao_RBC);
+                uint32_t ao_RF = VertexAO(ao_R, ao_F, ao_RFC);
+
+                merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos] = 0;
+                merged_right[bit_pos] = 0;
+
+                bool flipped = ao_LB + ao_RF > ao_RB + ao_LF;
+                if (sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+                    vertices.push_back(GetChunkQuad(mesh_left, mesh_front, mesh_up, mesh_right - mesh_left, mesh_back - mesh_front,
+                        blockData.faces[MeshFaceTextures[face]], face, ao_LF, ao_LB, ao_RF, ao_RB, !flipped, isGrass));
+                    TagSlice(vertex_slices, vertices, face, bit_pos);
+                    continue;
+                }
+
+                ChunkMesher::ChunkVertex v1{}, v2{}, v3{}, v4{};
+                switch (face) {
+                case 0: {
+                    TextureID texZ = blockData.faces[BACK_FACE];
+                    v1 = GetChunkVertex(mesh_left, mesh_up, mesh_front, ao_LF, 0, mesh_back - mesh_front, texZ, face, isGrass);
+                    v2 = GetChunkVertex(mesh_left, mesh_up, mesh_back, ao_LB, 0, 0, texZ, face, isGrass);
+                    v3 = GetChunkVertex(mesh_right, mesh_up, mesh_back, ao_RB, mesh_right - mesh_left, 0, texZ, face, isGrass);
+                    v4 = GetChunkVertex(mesh_right, mesh_up, mesh_front, ao_RF, mesh_right - mesh_left, mesh_back - mesh_front, texZ, face, isGrass);
+                    break;
+                }
+                case 1: {
+                    TextureID texZ = blockData.faces[FRONT_FACE];
+                    v1 = GetChunkVertex(mesh_left, mesh_up, mesh_back, ao_LB, 0, 0, texZ, face, isGrass);
+                    v2 = GetChunkVertex(mesh_left, mesh_up, mesh_front, ao_LF, 0, mesh_back - mesh_front, texZ, face, isGrass);
+                    v3 = GetChunkVertex(mesh_right, mesh_up, mesh_front, ao_RF, mesh_right - mesh_left, mesh_back - mesh_front, texZ, face, isGrass);
+                    v4 = GetChunkVertex(mesh_right, mesh_up, mesh_back, ao_RB, mesh_right - mesh_left, 0, texZ, face, isGrass);
+                    break;
+                }
+                case 2: {
+                    TextureID texZ = blockData.faces[RIGHT_FACE];
+                    v1 = GetChunkVertex(mesh_up, mesh_front, mesh_left, ao_LF, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
+                    v2 = GetChunkVertex(mesh_up, mesh_back, mesh_left, ao_LB, 0, mesh_right - mesh_left, texZ, face, isGrass);
+                    v3 = GetChunkVertex(mesh_up, mesh_back, mesh_right, ao_RB, 0, 0, texZ, face, isGrass);
+                    v4 = GetChunkVertex(mesh_up, mesh_front, mesh_right, ao_RF, mesh_back - mesh_front, 0, texZ, face, isGrass);
+                    break;
+                }
+                case 3: {
+                    TextureID texZ = blockData.faces[LEFT_FACE];
+                    v1 = GetChunkVertex(mesh_up, mesh_back, mesh_left, ao_LB, 0, mesh_right - mesh_left, texZ, face, isGrass);
+                    v2 = GetChunkVertex(mesh_up, mesh_front, mesh_left, ao_LF, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
+                    v3 = GetChunkVertex(mesh_up, mesh_front, mesh_right, ao_RF, mesh_back - mesh_front, 0, texZ, face, isGrass);
+                    v4 = GetChunkVertex(mesh_up, mesh_back, mesh_right, ao_RB, 0, 0, texZ, face, isGrass);
+                    break;
+                }
+                case 4: {
+                    TextureID texZ = blockData.faces[TOP_FACE];
+                    v1 = GetChunkVertex(mesh_front, mesh_left, mesh_up, ao_LF, 0, mesh_right - mesh_left, texZ, face, isGrass);
+                    v2 = GetChunkVertex(mesh_back, mesh_left, mesh_up, ao_LB, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
+                    v3 = GetChunkVertex(mesh_back, mesh_right, mesh_up, ao_RB, mesh_back - mesh_front, 0, texZ, face, isGrass);
+                    v4 = GetChunkVertex(mesh_front, mesh_right, mesh_up, ao_RF, 0, 0, texZ, face, isGrass);
+                    break;
+                }
+                case 5: {
+                    TextureID texZ = blockData.faces[BOTTOM_FACE];
+                    v1 = GetChunkVertex(mesh_back, mesh_left, mesh_up, ao_LB, 0, mesh_right - mesh_left, texZ, face, isGrass);
+                    v2 = GetChunkVertex(mesh_front, mesh_left, mesh_up, ao_LF, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
+                    v3 = GetChunkVertex(mesh_front, mesh_right, mesh_up, ao_RF, mesh_back - mesh_front, 0, texZ, face, isGrass);
+                    v4 = GetChunkVertex(mesh_back, mesh_right, mesh_up, ao_RB, 0, 0, texZ, face, isGrass);
+                    break;
+                }
+                }
+                InsertQuad(vertices, v1, v2, v3, v4, !flipped);
+                TagSlice(vertex_slices, vertices, face, bit_pos);
+            }
+        }
+    }
+}
+
+inline ChunkMesher::ChunkVertex GetCustomModelBlockVertex(uint32_t x, uint32_t y, uint32_t z, uint32_t texX, uint32_t texY, uint32_t type, bool isFoliage) {
+    return {
+        ((z) << 20) | ((y) << 10) | (x),
+        (isFoliage << 18) | (type << 10) | (texY << 5) | (texX)
+    };
+}
+
+// Model vertices of every block type with a custom model, with the texture and foliage flag baked in so
+// placing one in a chunk only needs its position offset added
+using CustomModelTemplates = std::array<std::vector<ChunkMesher::ChunkVertex>, static_cast<std::size_t>(BlockType::NUM_BLOCKS)>;
+
+static CustomModelTemplates BuildCustomModelTemplates() {
+    CustomModelTemplates templates;
+    for (std::size_t i = 0; i < static_cast<std::size_t>(BlockType::NUM_BLOCKS); i++) {
+        BlockType type = static_cast<BlockType>(i);
+        const BlockDataStruct& blockData = GetBlockData(type);
+        if (blockData.modelID == static_cast<ModelID>(Model::CUBE)) continue;
+
+        const BlockModel& modelVertices = BlockModels[blockData.modelID];
+        for (std::size_t j = 0; j + 4 < modelVertices.size(); j += 7) {
+            templates[i].push_back(GetCustomModelBlockVertex(
+                modelVertices[j],
+                modelVertices[j + 1],
+                modelVertices[j + 2],
+                modelVertices[j + 3],
+                modelVertices[j + 4],
+                blockData.faces[TOP_FACE],
+                type == BlockType::TALL_GRASS
+            ));
+        }
+    }
+    return templates;
+}
+
+// Built on first use, after the block data and models have been loaded
+static const CustomModelTemplates& GetCustomModelTemplates() {
+    static const CustomModelTemplates templates = BuildCustomModelTemplates();
+    return templates;
+}
+
+// Places the model of every custom model block in the given layers that isn't enclosed by solid blocks, scanning
+// the custom model and solid columns along y so only occupied voxels are visited, in memory order
+static void MeshCustomModelBlocks(std::vector<ChunkMesher::ChunkVertex>& vertices, std::vector<uint16_t>& vertex_slices, const std::vector<Block>& blocks, const uint64_t* axis_cols, uint64_t layers) {
+    const uint64_t* custom_model_cols = &axis_cols[(AXIS_COLS_SIZE * ChunkMesher::CUSTOM_MODEL_CLASS) + (Chunk::SIZE_PADDED_SQUARED * 2)];
+    const uint64_t* solid_cols = &axis_cols[(AXIS_COLS_SIZE * ChunkMesher::SOLID_CLASS) + (Chunk::SIZE_PADDED_SQUARED * 2)];
+    const CustomModelTemplates& templates = GetCustomModelTemplates();
+    const uint64_t interior_layers = ~(1ULL | (1ULL << (Chunk::SIZE_PADDED - 1))) & layers;
+    for (int z = 1; z < Chunk::SIZE_PADDED_SUB_1; z++) {
+        for (int x = 1; x < Chunk::SIZE_PADDED_SUB_1; x++) {
+            int i = z + (x * Chunk::SIZE_PADDED);
+            uint64_t models = custom_model_cols[i] & interior_layers;
+            if (models == 0) continue;
+
+            uint64_t solid = solid_cols[i];
+            uint64_t enclosed = (solid >> 1) & (solid << 1) &
+                solid_cols[i - 1] & solid_cols[i + 1] &
+                solid_cols[i - Chunk::SIZE_PADDED] & solid_cols[i + Chunk::SIZE_PADDED];
+            models &= ~enclosed;
+
+            while (models) {
+                int y = CTZ(models);
+                models &= models - 1;
+
+                Block block = blocks[VoxelIndex(glm::ivec3(x, y, z))];
+                uint32_t offset = (((z - 1) * 16) << 20) | (((y - 1) * 16) << 10) | ((x - 1) * 16);
+                for (ChunkMesher::ChunkVertex vertex : templates[static_cast<std::size_t>(block.GetType())]) {
+                    vertices.push_back(ChunkMesher::ChunkVertex{ vertex.data1 + offset, vertex.data2 });
+                }
+                TagSlice(vertex_slices, vertices, ChunkMesher::CUSTOM_MODEL_SLICE_FACE, y);
+            }
+        }
+    }
+}
+
+static std::atomic<std::size_t> sMeshCalls = 0;
+static std::atomic<uint64_t> sMeshNanoseconds = 0;
+
+ChunkMesher::MeshTimings ChunkMesher::GetMeshTimings() {
+    return MeshTimings{
+        sMeshCalls.load(),
+        static_cast<double>(sMeshNanoseconds.load()) / 1000.0
+    };
+}
+
+void ChunkMesher::ResetMeshTimings() {
+    sMeshCalls = 0;
+    sMeshNanoseconds = 0;
+}
+
+// Layers within one layer of those in a mask
+inline uint64_t DilateLayers(uint64_t layers) {
+    return layers | (layers << 1) | (layers >> 1);
+}
+
+ChunkMesher::SliceMask ChunkMesher::GetBlockSlices(int x, int y, int z) {
+    uint64_t z_layers = DilateLayers(1ULL << z);
+    uint64_t x_layers = DilateLayers(1ULL << x);
+    uint64_t y_layers = DilateLayers(1ULL << y);
+    return SliceMask{ z_layers, z_layers, x_layers, x_layers, y_layers, y_layers };
+}
+
+// Classifies only the given layers of each axis into that axis' columns, for remeshing a few slices
+static void ClassifyLayers(std::vector<uint64_t>& axis_cols, uint64_t* class_present, const std::vector<Block>& blocks, const uint64_t* axis_layers) {
+    const VoxelClassTable& classTable = GetVoxelClassTable();
+    for (int axis = 0; axis <= 2; axis++) {
+        uint64_t layers = axis_layers[axis];
+        while (layers) {
+            int c = CTZ(layers);
+            layers &= layers - 1;
+            for (int forward = 0; forward < Chunk::SIZE_PADDED; forward++) {
+                for (int right = 0; right < Chunk::SIZE_PADDED; right++) {
+                    uint32_t classes = GetVoxelClasses(classTable, blocks[GetAxisIndex(axis, right, forward, c)]);
+                    for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+                        uint64_t bit = static_cast<uint64_t>((classes >> voxel_class) & 1) << c;
+                        axis_cols[(AXIS_COLS_SIZE * voxel_class) + (Chunk::SIZE_PADDED_SQUARED * axis) + right + (forward * Chunk::SIZE_PADDED)] |= bit;
+                        class_present[voxel_class] |= bit;
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint32_t ChunkMesher::GetHistogramClasses(const BlockHistogram& histogram) {
+    const VoxelClassTable& classTable = GetVoxelClassTable();
+    uint32_t classes = 0;
+    for (std::size_t type = 0; type < histogram.counts.size(); type++) {
+        if (histogram.counts[type] > 0) classes |= classTable[type];
+    }
+    if (histogram.waterLogged > 0) classes |= 1 << WATER_MATERIAL;
+    return classes;
+}
+
+// Classifies every voxel into the columns of the given classes, leaving the columns of the others untouched.
+// The classes are known at compile time so the loop over them is fully unrolled
+template <uint32_t Classes>
+static void ClassifyAllLayers(std::vector<uint64_t>& axis_cols, uint64_t* class_present, const std::vector<Block>& blocks) {
+    const VoxelClassTable& classTable = GetVoxelClassTable();
+    for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+        if ((Classes >> voxel_class) & 1) {
+            std::fill_n(axis_cols.begin() + (AXIS_COLS_SIZE * voxel_class), AXIS_COLS_SIZE, 0);
+        }
+    }
+
     int index = 0;
     for (int y = 0; y < Chunk::SIZE_PADDED; y++) {
         for (int x = 0; x < Chunk::SIZE_PADDED; x++) {
-            uint64_t zb = 0;
+            uint64_t zb[ChunkMesher::NUM_VOXEL_CLASSES] = { 0 };
             for (int z = 0; z < Chunk::SIZE_PADDED; z++) {
-                if (condition(blocks[index])) {
-                    axis_cols[x + (z * Chunk::SIZE_PADDED)] |= 1ULL << y;
-                    axis_cols[z + (y * Chunk::SIZE_PADDED) + (Chunk::SIZE_PADDED_SQUARED)] |= 1ULL << x;
-                    zb |= 1ULL << z;
+                uint32_t classes = GetVoxelClasses(classTable, blocks[index]);
+                // Branch free so the loop over the classes is fully unrolled
+                for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+                    if (!((Classes >> voxel_class) & 1)) continue;
+                    uint64_t bit = (classes >> voxel_class) & 1;
+                    uint64_t* class_cols = &axis_cols[AXIS_COLS_SIZE * voxel_class];
+                    class_cols[x + (z * Chunk::SIZE_PADDED)] |= bit << y;
+                    class_cols[z + (y * Chunk::SIZE_PADDED) + (Chunk::SIZE_PADDED_SQUARED)] |= bit << x;
+                    zb[voxel_class] |= bit << z;
                 }
                 index++;
             }
-            axis_cols[y + (x * Chunk::SIZE_PADDED) + (Chunk::SIZE_PADDED_SQUARED * 2)] = zb;
+            for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+                if (!((Classes >> voxel_class) & 1)) continue;
+                axis_cols[(AXIS_COLS_SIZE * voxel_class) + y + (x * Chunk::SIZE_PADDED) + (Chunk::SIZE_PADDED_SQUARED * 2)] = zb[voxel_class];
+                class_present[voxel_class] |= zb[voxel_class];
+            }
         }
     }
+}
 
+// Turns the rows of a 64x64 bit matrix into its columns, bit j of row i trading places with bit i of row j. Each
+// step swaps the two off diagonal blocks within every block on the diagonal, halving the block size from 32 to 1
+static void TransposeBitMatrix(uint64_t* rows) {
+    uint64_t mask = 0x00000000FFFFFFFFULL;
+    for (int width = 32; width != 0; width >>= 1, mask ^= mask << width) {
+        for (int row = 0; row < 64; row = ((row | width) + 1) & ~width) {
+            uint64_t swap = ((rows[row] >> width) ^ rows[row | width]) & mask;
+            rows[row] ^= swap << width;
+            rows[row | width] ^= swap;
+        }
+    }
+}
 
-    // Step 2: Visible face culling
-    std::vector<uint64_t> col_face_masks(Chunk::SIZE_PADDED_SQUARED * 6);
-    for (int axis = 0; axis <= 2; axis++) {
+#ifdef HAS_AVX2_CLASSIFY
+// Classes of 16 blocks, in the low byte of each 16 bit lane. Types past the lookup have no classes, as in the table
+TARGET_AVX2 static inline __m256i ClassifyBlocksAVX2(const Block* blocks, __m256i classLookup) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks));
+    const __m256i type = _mm256_and_si256(_mm256_srli_epi16(block, 6), _mm256_set1_epi16(0xFF));
+    const __m256i inLookup = _mm256_and_si256(_mm256_cmpgt_epi16(_mm256_set1_epi16(16), type), _mm256_set1_epi16(0xFF));
+    const __m256i classes = _mm256_and_si256(_mm256_shuffle_epi8(classLookup, type), inLookup);
+    const __m256i waterLogged = _mm256_slli_epi16(_mm256_and_si256(block, _mm256_set1_epi16(1)), ChunkMesher::WATER_MATERIAL);
+    return _mm256_or_si256(classes, waterLogged);
+}
+
+// Same columns as ClassifyAllLayers, without its scattered single bit writes. The blocks of each column along the
+// innermost axis are classified 16 at a time and their class bits gathered with byte masks, then the columns of
+// the other two axes are the transposes of 64x64 blocks of those columns
+template <uint32_t Classes>
+TARGET_AVX2 static void ClassifyAllLayersAVX2(std::vector<uint64_t>& axis_cols, uint64_t* class_present, const std::vector<Block>& blocks) {
+    static_assert(sizeof(Block) == sizeof(uint16_t));
+    const VoxelClassTable& classTable = GetVoxelClassTable();
+    const __m256i classLookup = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(classTable.data())));
+
+    // Columns along x of one y layer, over z, which transpose into the columns along z of that layer
+    uint64_t layer_cols[ChunkMesher::NUM_VOXEL_CLASSES][Chunk::SIZE_PADDED];
+    const Block* column = blocks.data();
+    for (int y = 0; y < Chunk::SIZE_PADDED; y++) {
+        for (int x = 0; x < Chunk::SIZE_PADDED; x++) {
+            uint64_t zb[ChunkMesher::NUM_VOXEL_CLASSES] = { 0 };
+            for (int half = 0; half < 2; half++) {
+                const Block* half_blocks = column + (half * 32);
+                __m256i classes = _mm256_packus_epi16(ClassifyBlocksAVX2(half_blocks, classLookup), ClassifyBlocksAVX2(half_blocks + 16, classLookup));
+                // Packing interleaves the 128 bit lanes of its two inputs, put the bytes back in block order
+                classes = _mm256_permute4x64_epi64(classes, 0b11011000);
+                for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+                    if (!((Classes >> voxel_class) & 1)) continue;
+                    // Shifting 16 bit lanes left never moves a bit from one byte into the top bit of the other
+                    uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(classes, 7 - voxel_class)));
+                    zb[voxel_class] |= static_cast<uint64_t>(bits) << (half * 32);
+                }
+            }
+            for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+                if (!((Classes >> voxel_class) & 1)) continue;
+                axis_cols[(AXIS_COLS_SIZE * voxel_class) + y + (x * Chunk::SIZE_PADDED) + (Chunk::SIZE_PADDED_SQUARED * 2)] = zb[voxel_class];
+                layer_cols[voxel_class][x] = zb[voxel_class];
+                class_present[voxel_class] |= zb[voxel_class];
+            }
+            column += Chunk::SIZE_PADDED;
+        }
+        for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+            if (!((Classes >> voxel_class) & 1)) continue;
+            TransposeBitMatrix(layer_cols[voxel_class]);
+            std::copy_n(layer_cols[voxel_class], Chunk::SIZE_PADDED, &axis_cols[(AXIS_COLS_SIZE * voxel_class) + (y * Chunk::SIZE_PADDED) + Chunk::SIZE_PADDED_SQUARED]);
+        }
+    }
+
+    // The columns over y at one x are already side by side among the columns of the innermost axis, their
+    // transpose is the columns along y at that x
+    for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+        if (!((Classes >> voxel_class) & 1)) continue;
+        uint64_t* class_cols = &axis_cols[AXIS_COLS_SIZE * voxel_class];
+        uint64_t x_cols[Chunk::SIZE_PADDED];
+        for (int x = 0; x < Chunk::SIZE_PADDED; x++) {
+            std::copy_n(&class_cols[(x * Chunk::SIZE_PADDED) + (Chunk::SIZE_PADDED_SQUARED * 2)], Chunk::SIZE_PADDED, x_cols);
+            TransposeBitMatrix(x_cols);
+            for (int z = 0; z < Chunk::SIZE_PADDED; z++) {
+                class_cols[x + (z * Chunk::SIZE_PADDED)] = x_cols[z];
+            }
+        }
+    }
+}
+#endif
+
+#ifndef NDEBUG
+// Debug builds check the SIMD kernel against the scalar classification of the same blocks
+template <uint32_t Classes>
+static void CheckClassifyAllLayers(const std::vector<uint64_t>& axis_cols, const uint64_t* class_present, const std::vector<Block>& blocks) {
+    thread_local std::vector<uint64_t> scalar_cols(AXIS_COLS_SIZE * ChunkMesher::NUM_VOXEL_CLASSES);
+    uint64_t scalar_present[ChunkMesher::NUM_VOXEL_CLASSES] = { 0 };
+    ClassifyAllLayers<Classes>(scalar_cols, scalar_present, blocks);
+    for (int voxel_class = 0; voxel_class < ChunkMesher::NUM_VOXEL_CLASSES; voxel_class++) {
+        if (!((Classes >> voxel_class) & 1)) continue;
+        auto offset = AXIS_COLS_SIZE * voxel_class;
+        if (class_present[voxel_class] != scalar_present[voxel_class] ||
+            !std::equal(axis_cols.begin() + offset, axis_cols.begin() + offset + AXIS_COLS_SIZE, scalar_cols.begin() + offset)) {
+            LOG_ERROR("SIMD voxel classification differs from the scalar classification for class {}", voxel_class);
+        }
+    }
+}
+#endif
+
+template <uint32_t Classes>
+static void ClassifyChunk(std::vector<uint64_t>& axis_cols, uint64_t* class_present, const std::vector<Block>& blocks) {
+#ifdef HAS_AVX2_CLASSIFY
+    if (sSIMDClassify) {
+        ClassifyAllLayersAVX2<Classes>(axis_cols, class_present, blocks);
+#ifndef NDEBUG
+        CheckClassifyAllLayers<Classes>(axis_cols, class_present, blocks);
+#endif
+        return;
+    }
+#endif
+    ClassifyAllLayers<Classes>(axis_cols, class_present, blocks);
+}
+
+constexpr ChunkMesher::MeshStreamID MATERIAL_STREAMS[ChunkMesher::NUM_MESH_MATERIALS] = { ChunkMesher::OPAQUE_STREAM, ChunkMesher::OPAQUE_STREAM, ChunkMesher::WATER_STREAM };
+
+// Steps 2 and 3 for the faces of one material in one direction, which share nothing with any other material or
+// direction but the classified columns
+static void MeshMaterialFace(std::vector<ChunkMesher::ChunkVertex>& vertices, std::vector<uint16_t>& vertex_slices, const std::vector<Block>& blocks, const uint64_t* axis_cols, int material, int face, uint64_t face_slices, MesherScratch& scratch) {
+    // Step 2: Visible face culling, keeping only the faces in the slices being meshed
+    const uint64_t* material_cols = &axis_cols[(AXIS_COLS_SIZE * material) + (Chunk::SIZE_PADDED_SQUARED * (face / 2))];
+    uint64_t* face_masks = scratch.col_face_masks.data();
+    if (face % 2 == 0) {
+        for (int i = 0; i < Chunk::SIZE_PADDED_SQUARED; i++) {
+            face_masks[i] = material_cols[i] & ~((material_cols[i] >> 1) | (1ULL << (Chunk::SIZE_PADDED - 1))) & face_slices;
+        }
+    }
+    else {
         for (int i = 0; i < Chunk::SIZE_PADDED_SQUARED; i++) {
-            uint64_t col = axis_cols[(Chunk::SIZE_PADDED_SQUARED * axis) + i];
-            col_face_masks[(Chunk::SIZE_PADDED_SQUARED * (axis * 2)) + i] = col & ~((col >> 1) | (1ULL << (Chunk::SIZE_PADDED - 1)));
-            col_face_masks[(Chunk::SIZE_PADDED_SQUARED * (axis * 2 + 1)) + i] = col & ~((col << 1) | 1ULL);
+            face_masks[i] = material_cols[i] & ~((material_cols[i] << 1) | 1ULL) & face_slices;
         }
     }
 
     // Step 3: Greedy meshing
-    for (int face = 0; face < 6; face++) {
-        int axis = face / 2;
-        int light_dir = face % 2 == 0 ? 1 : -1;
-
-        std::vector<int> merged_forward(Chunk::SIZE_PADDED_SQUARED);
-        for (int forward = 1; forward < Chunk::SIZE_PADDED - 1; forward++) {
-            uint64_t bits_walking_right = 0;
-            int merged_right[Chunk::SIZE_PADDED] = { 0 };
-            for (int right = 1; right < Chunk::SIZE_PADDED - 1; right++) {
-                uint64_t bits_here = col_face_masks[right + (forward * Chunk::SIZE_PADDED) + (face * Chunk::SIZE_PADDED_SQUARED)];
-                uint64_t bits_forward = forward >= Chunk::SIZE ? 0 : col_face_masks[right + (forward * Chunk::SIZE_PADDED) + (face * Chunk::SIZE_PADDED_SQUARED) + Chunk::SIZE_PADDED];
-                uint64_t bits_right = right >= Chunk::SIZE ? 0 : col_face_masks[right + 1 + (forward * Chunk::SIZE_PADDED) + (face * Chunk::SIZE_PADDED_SQUARED)];
-                uint64_t bits_merging_forward = bits_here & bits_forward & ~bits_walking_right;
-                uint64_t bits_merging_right = bits_here & bits_right;
-
-                uint64_t copy_front = bits_merging_forward;
-
-                while (copy_front) {
-                    int bit_pos = CTZ(copy_front);
-                    copy_front &= ~(1ULL << bit_pos);
-
-                    if (bit_pos == 0 || bit_pos == Chunk::SIZE_PADDED - 1) continue;
-
-                    if (CompareForward(blocks, axis, forward, right, bit_pos, light_dir)) {
-                        merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos]++;
-                    }
-                    else {
-                        bits_merging_forward &= ~(1ULL << bit_pos);
+    GreedyMeshFace(vertices, vertex_slices, blocks, face_masks, &axis_cols[AXIS_COLS_SIZE * ChunkMesher::SOLID_CLASS], scratch.merged_forward, face);
+}
+
+// Runs the tasks of steps 2 and 3 on a thread pool, each into its own buffers in the calling thread's scratch, then
+// joins them in the order they run in one after the other so the mesh comes out the same. Each task takes the
+// scratch of the pool thread it runs on
+static void MeshTasksInParallel(MesherScratch& scratch, const std::vector<Block>& blocks, const uint64_t* class_present, const ChunkMesher::SliceMask& slices, BS::thread_pool& pool) {
+    const uint64_t* axis_cols = scratch.axis_cols.data();
+    std::array<std::size_t, NUM_MESH_TASKS> vertexCapacities;
+    std::array<std::size_t, NUM_MESH_TASKS> sliceCapacities;
+    for (int task = 0; task < NUM_MESH_TASKS; task++) {
+        scratch.task_vertices[task].clear();
+        scratch.task_slices[task].clear();
+        vertexCapacities[task] = scratch.task_vertices[task].capacity();
+        sliceCapacities[task] = scratch.task_slices[task].capacity();
+    }
+
+    BS::multi_future<void> tasks;
+    for (int material = 0; material < ChunkMesher::NUM_MESH_MATERIALS; material++) {
+        if (class_present[material] == 0) continue;
+        for (int face = 0; face < 6; face++) {
+            if (slices[face] == 0) continue;
+            int task = (material * 6) + face;
+            tasks.push_back(pool.submit([&scratch, &blocks, axis_cols, task, material, face, face_slices = slices[face]] {
+                MeshMaterialFace(scratch.task_vertices[task], scratch.task_slices[task], blocks, axis_cols, material, face, face_slices, GetMesherScratch());
+            }));
+        }
+    }
+    if (class_present[ChunkMesher::CUSTOM_MODEL_CLASS] != 0) {
+        tasks.push_back(pool.submit([&scratch, &blocks, axis_cols, layers = slices[ChunkMesher::CUSTOM_MODEL_SLICE_FACE]] {
+            MeshCustomModelBlocks(scratch.task_vertices[NUM_FACE_TASKS], scratch.task_slices[NUM_FACE_TASKS], blocks, axis_cols, layers);
+        }));
+    }
+    tasks.wait();
+
+    for (int task = 0; task < NUM_MESH_TASKS; task++) {
+        ChunkMesher::MeshStreamID stream = task < NUM_FACE_TASKS ? MATERIAL_STREAMS[task / 6] : ChunkMesher::CUSTOM_MODEL_STREAM;
+        scratch.unsorted_vertices[stream].insert(scratch.unsorted_vertices[stream].end(), scratch.task_vertices[task].begin(), scratch.task_vertices[task].end());
+        scratch.vertex_slices[stream].insert(scratch.vertex_slices[stream].end(), scratch.task_slices[task].begin(), scratch.task_slices[task].end());
+        CountGrowth(scratch.task_vertices[task], vertexCapacities[task]);
+        CountGrowth(scratch.task_slices[task], sliceCapacities[task]);
+    }
+}
+
+void ChunkMesher::BinaryGreedyMesh(ChunkMesh& mesh, const std::vector<Block>& blocks, const SliceMask& slices, uint32_t chunkClasses, BS::thread_pool* pool) {
+    auto start = std::chrono::steady_clock::now();
+    MesherScratch& scratch = GetMesherScratch();
+    std::array<std::size_t, NUM_MESH_STREAMS> unsortedCapacities;
+    std::array<std::size_t, NUM_MESH_STREAMS> vertexSlicesCapacities;
+    for (int stream = 0; stream < NUM_MESH_STREAMS; stream++) {
+        scratch.unsorted_vertices[stream].clear();
+        scratch.vertex_slices[stream].clear();
+        unsortedCapacities[stream] = scratch.unsorted_vertices[stream].capacity();
+        vertexSlicesCapacities[stream] = scratch.vertex_slices[stream].capacity();
+    }
+
+    // The faces of a slice depend on the layers either side of it, through culling and AO
+    uint64_t axis_layers[3];
+    for (int axis = 0; axis <= 2; axis++) {
+        axis_layers[axis] = DilateLayers(slices[axis * 2] | slices[(axis * 2) + 1]);
+    }
+    bool allLayers = axis_layers[0] == ~0ULL && axis_layers[1] == ~0ULL && axis_layers[2] == ~0ULL;
+
+    // Step 1: Convert to binary column representation for each direction, classifying each voxel once
+    // The opacity of every voxel is stored in the same layout, AO is sampled from it in step 3
+    std::vector<uint64_t>& axis_cols = scratch.axis_cols;
+    uint64_t class_present[NUM_VOXEL_CLASSES] = { 0 };
+    if (!allLayers) {
+        std::fill(axis_cols.begin(), axis_cols.end(), 0);
+        ClassifyLayers(axis_cols, class_present, blocks, axis_layers);
+    }
+    else if ((chunkClasses & ~CUBE_CLASSES) == 0) {
+        // Glass, water and custom models only make faces inside the chunk, so a chunk without any skips their
+        // classes, whose stale columns are never read as nothing is present in them
+        ClassifyChunk<CUBE_CLASSES>(axis_cols, class_present, blocks);
+    }
+    else {
+        ClassifyChunk<ALL_VOXEL_CLASSES>(axis_cols, class_present, blocks);
+    }
+
+    if (pool != nullptr) {
+        MeshTasksInParallel(scratch, blocks, class_present, slices, *pool);
+    }
+    else {
+        for (int material = 0; material < NUM_MESH_MATERIALS; material++) {
+            if (class_present[material] == 0) continue;
+            MeshStreamID stream = MATERIAL_STREAMS[material];
+            for (int face = 0; face < 6; face++) {
+                if (slices[face] == 0) continue;
+                MeshMaterialFace(scratch.unsorted_vertices[stream], scratch.vertex_slices[stream], blocks, axis_cols.data(), material, face, slices[face], scratch);
+            }
+        }
+        if (class_present[CUSTOM_MODEL_CLASS] != 0) {
+            MeshCustomModelBlocks(scratch.unsorted_vertices[CUSTOM_MODEL_STREAM], scratch.vertex_slices[CUSTOM_MODEL_STREAM], blocks, axis_cols.data(), slices[CUSTOM_MODEL_SLICE_FACE]);
+        }
+    }
+
+    // Step 4: Group the vertices of every stream by slice
+    for (int stream = 0; stream < NUM_MESH_STREAMS; stream++) {
+        SortBySlice(mesh[stream], scratch.unsorted_vertices[stream], scratch.vertex_slices[stream]);
+        CountGrowth(scratch.unsorted_vertices[stream], unsortedCapacities[stream]);
+        CountGrowth(scratch.vertex_slices[stream], vertexSlicesCapacities[stream]);
+    }
+
+    // Only whole chunks are timed so the average stays comparable
+    if (allLayers) {
+        sMeshCalls++;
+        sMeshNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void ChunkMesher::DownsampleBlocks(const std::vector<Block>& blocks, int scale, std::vector<Block>& lodBlocks) {
+    const VoxelClassTable& classTable = GetVoxelClassTable();
+    constexpr uint32_t solid_classes = (1 << OPAQUE_MATERIAL) | (1 << GLASS_MATERIAL);
+    constexpr int max_cells = Chunk::SIZE;
+    // Cells are tallied in one pass over the blocks in memory order, a column at a time
+    struct CellTally {
+        uint16_t solid;
+        uint16_t water;
+        int8_t surfaceY;
+        BlockType surface;
+    };
+    thread_local std::vector<CellTally> tallies(max_cells * max_cells * max_cells);
+    // Scales are powers of two, so blocks are mapped to cells with shifts
+    int shift = CTZ(static_cast<uint64_t>(scale));
+    int cells = (Chunk::SIZE + scale - 1) >> shift;
+    std::fill_n(tallies.begin(), cells * cells * cells, CellTally{ 0, 0, -1, BlockType::AIR });
+
+    for (int z = 1; z <= Chunk::SIZE; z++) {
+        for (int x = 1; x <= Chunk::SIZE; x++) {
+            CellTally* column = &tallies[((((z - 1) >> shift) * cells) + ((x - 1) >> shift)) * cells];
+            const Block* column_blocks = &blocks[VoxelIndex(glm::ivec3(x, 0, z))];
+            for (int y = 1; y <= Chunk::SIZE; y++) {
+                uint32_t classes = GetVoxelClasses(classTable, column_blocks[y]);
+                CellTally& tally = column[(y - 1) >> shift];
+                if (classes & solid_classes) {
+                    tally.solid++;
+                    // The highest solid block is the cell's surface
+                    if (y > tally.surfaceY) {
+                        tally.surfaceY = static_cast<int8_t>(y);
+                        tally.surface = column_blocks[y].GetType();
                     }
                 }
+                else if (classes & (1 << WATER_MATERIAL)) {
+                    tally.water++;
+                }
+            }
+        }
+    }
 
-                uint64_t bits_stopped_forward = bits_here & ~bits_merging_forward;
-                while (bits_stopped_forward) {
-                    int bit_pos = CTZ(bits_stopped_forward);
-                    bits_stopped_forward &= ~(1ULL << bit_pos);
-
-                    // Discards faces from neighbor blocks
-                    if (bit_pos == 0 || bit_pos == Chunk::SIZE_PADDED - 1) { continue; };
-
-                    if (
-                        (bits_merging_right & (1ULL << bit_pos)) != 0 &&
-                        merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos] == merged_forward[(right + 1) * Chunk::SIZE_PADDED + bit_pos] &&
-                        CompareRight(blocks, axis, forward, right, bit_pos, light_dir))
-                    {
-                        bits_walking_right |= 1ULL << bit_pos;
-                        merged_right[bit_pos]++;
-                        merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos] = 0;
-                        continue;
-                    }
-                    bits_walking_right &= ~(1ULL << bit_pos);
-
-                    uint8_t mesh_left = right - merged_right[bit_pos];
-                    uint8_t mesh_right = right + 1;
-                    uint8_t mesh_front = forward - merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos];
-                    uint8_t mesh_back = forward + 1;
-                    uint8_t mesh_up = bit_pos + (face % 2 == 0 ? 1 : 0);
-
-                    Block block = blocks[GetAxisIndex(axis, right, forward, bit_pos)];
-                    BlockType type = block.IsWaterLogged() ? BlockType::WATER : block.GetType();
-                    bool isGrass = type == BlockType::GRASS;
-                    const BlockDataStruct& blockData = GetBlockData(type);
-
-                    int c = bit_pos + light_dir;
-                    bool ao_F = SolidCheck(blocks[GetAxisIndex(axis, right, forward - 1, c)].GetType());
-                    bool ao_B = SolidCheck(blocks[GetAxisIndex(axis, right, forward + 1, c)].GetType());
-                    bool ao_L = SolidCheck(blocks[GetAxisIndex(axis, right - 1, forward, c)].GetType());
-                    bool ao_R = SolidCheck(blocks[GetAxisIndex(axis, right + 1, forward, c)].GetType());
-
-                    bool ao_LFC = SolidCheck(blocks[GetAxisIndex(axis, right - 1, forward - 1, c)].GetType());
-                    bool ao_LBC = SolidCheck(blocks[GetAxisIndex(axis, right - 1, forward + 1, c)].GetType());
-                    bool ao_RFC = SolidCheck(blocks[GetAxisIndex(axis, right + 1, forward - 1, c)].GetType());
-                    bool ao_RBC = SolidCheck(blocks[GetAxisIndex(axis, right + 1, forward + 1, c)].GetType());
-
-                    uint32_t ao_LB = VertexAO(ao_L, ao_B, ao_LBC);
-                    uint32_t ao_LF = VertexAO(ao_L, ao_F, ao_LFC);
-                    uint32_t ao_RB = VertexAO(ao_R, ao_B, ao_RBC);
-                    uint32_t ao_RF = VertexAO(ao_R, ao_F, ao_RFC);
+    // Cells are solid when at least half solid, water when at least half water or solid
+    auto extent = [scale](int cell) { return std::min(scale, Chunk::SIZE - (cell * scale)); };
+    for (int i = 0; i < cells * cells * cells; i++) {
+        CellTally& tally = tallies[i];
+        int cz = i / (cells * cells);
+        int cx = (i / cells) % cells;
+        int cy = i % cells;
+        int volume = extent(cz) * extent(cx) * extent(cy);
+        if (tally.solid * 2 < volume) {
+            tally.surface = (tally.solid + tally.water) * 2 >= volume ? BlockType::WATER : BlockType::AIR;
+        }
+    }
 
-                    merged_forward[(right * Chunk::SIZE_PADDED) + bit_pos] = 0;
-                    merged_right[bit_pos] = 0;
-
-                    ChunkVertex v1{}, v2{}, v3{}, v4{};
-                    switch (face) {
-                    case 0: {
-                        TextureID texZ = blockData.faces[BACK_FACE];
-                        v1 = GetChunkVertex(mesh_left, mesh_up, mesh_front, ao_LF, 0, mesh_back - mesh_front, texZ, face, isGrass);
-                        v2 = GetChunkVertex(mesh_left, mesh_up, mesh_back, ao_LB, 0, 0, texZ, face, isGrass);
-                        v3 = GetChunkVertex(mesh_right, mesh_up, mesh_back, ao_RB, mesh_right - mesh_left, 0, texZ, face, isGrass);
-                        v4 = GetChunkVertex(mesh_right, mesh_up, mesh_front, ao_RF, mesh_right - mesh_left, mesh_back - mesh_front, texZ, face, isGrass);
-                        break;
-                    }
-                    case 1: {
-                        TextureID texZ = blockData.faces[FRONT_FACE];
-                        v1 = GetChunkVertex(mesh_left, mesh_up, mesh_back, ao_LB, 0, 0, texZ, face, isGrass);
-                        v2 = GetChunkVertex(mesh_left, mesh_up, mesh_front, ao_LF, 0, mesh_back - mesh_front, texZ, face, isGrass);
-                        v3 = GetChunkVertex(mesh_right, mesh_up, mesh_front, ao_RF, mesh_right - mesh_left, mesh_back - mesh_front, texZ, face, isGrass);
-                        v4 = GetChunkVertex(mesh_right, mesh_up, mesh_back, ao_RB, mesh_right - mesh_left, 0, texZ, face, isGrass);
-                        break;
-                    }
-                    case 2: {
-                        TextureID texZ = blockData.faces[RIGHT_FACE];
-                        v1 = GetChunkVertex(mesh_up, mesh_front, mesh_left, ao_LF, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
-                        v2 = GetChunkVertex(mesh_up, mesh_back, mesh_left, ao_LB, 0, mesh_right - mesh_left, texZ, face, isGrass);
-                        v3 = GetChunkVertex(mesh_up, mesh_back, mesh_right, ao_RB, 0, 0, texZ, face, isGrass);
-                        v4 = GetChunkVertex(mesh_up, mesh_front, mesh_right, ao_RF, mesh_back - mesh_front, 0, texZ, face, isGrass);
-                        break;
-                    }
-                    case 3: {
-                        TextureID texZ = blockData.faces[LEFT_FACE];
-                        v1 = GetChunkVertex(mesh_up, mesh_back, mesh_left, ao_LB, 0, mesh_right - mesh_left, texZ, face, isGrass);
-                        v2 = GetChunkVertex(mesh_up, mesh_front, mesh_left, ao_LF, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
-                        v3 = GetChunkVertex(mesh_up, mesh_front, mesh_right, ao_RF, mesh_back - mesh_front, 0, texZ, face, isGrass);
-                        v4 = GetChunkVertex(mesh_up, mesh_back, mesh_right, ao_RB, 0, 0, texZ, face, isGrass);
-                        break;
-                    }
-                    case 4: {
-                        TextureID texZ = blockData.faces[TOP_FACE];
-                        v1 = GetChunkVertex(mesh_front, mesh_left, mesh_up, ao_LF, 0, mesh_right - mesh_left, texZ, face, isGrass);
-                        v2 = GetChunkVertex(mesh_back, mesh_left, mesh_up, ao_LB, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
-                        v3 = GetChunkVertex(mesh_back, mesh_right, mesh_up, ao_RB, mesh_back - mesh_front, 0, texZ, face, isGrass);
-                        v4 = GetChunkVertex(mesh_front, mesh_right, mesh_up, ao_RF, 0, 0, texZ, face, isGrass);
-                        break;
+    // The padding is left as air
+    std::fill(lodBlocks.begin(), lodBlocks.end(), Block(BlockType::AIR, 0, false));
+    for (int z = 1; z <= Chunk::SIZE; z++) {
+        for (int x = 1; x <= Chunk::SIZE; x++) {
+            const CellTally* column = &tallies[((((z - 1) >> shift) * cells) + ((x - 1) >> shift)) * cells];
+            Block* column_blocks = &lodBlocks[VoxelIndex(glm::ivec3(x, 0, z))];
+            for (int y = 1; y <= Chunk::SIZE; y++) {
+                column_blocks[y] = Block(column[(y - 1) >> shift].surface, 0, false);
+            }
+        }
+    }
+}
+
+// Vertices per quad of a stream, custom models are always made of 4 vertex quads
+inline uint32_t GetStreamQuadVertices(int stream) {
+    if (stream != ChunkMesher::CUSTOM_MODEL_STREAM && sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        return 1;
+    }
+    return QuadElementBuffer::VERTICES_PER_QUAD;
+}
+
+std::size_t ChunkMesher::GetQuadCount(const ChunkMesh& mesh) {
+    std::size_t quads = 0;
+    for (int stream = 0; stream < NUM_MESH_STREAMS; stream++) {
+        quads += mesh[stream].vertices.size() / GetStreamQuadVertices(stream);
+    }
+    return quads;
+}
+
+inline ChunkMesher::ChunkVertex SetStackIndex(ChunkMesher::ChunkVertex vertex, int stream, uint32_t index) {
+    if (stream == ChunkMesher::CUSTOM_MODEL_STREAM) {
+        vertex.data1 |= index << 30;
+    }
+    else if (sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        vertex.data2 |= index << 19;
+    }
+    else {
+        vertex.data1 |= index << 20;
+    }
+    return vertex;
+}
+
+// Vertical extent of a side face quad, stored one below its position in the chunk so it runs from 0 to Chunk::SIZE
+struct SideQuadSpan {
+    uint32_t bottom;
+    uint32_t height;
+};
+
+inline SideQuadSpan GetSideQuadSpan(const ChunkMesher::ChunkVertex* quad, int face) {
+    if (sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        // Faces 0 and 1 run forward up the chunk, faces 2 and 3 run right
+        if (face < 2) {
+            return SideQuadSpan{ (quad->data1 >> 6) & 63, (quad->data1 >> 24) & 63 };
+        }
+        return SideQuadSpan{ quad->data1 & 63, (quad->data1 >> 18) & 63 };
+    }
+
+    uint32_t bottom = Chunk::SIZE_PADDED_SUB_1;
+    uint32_t top = 0;
+    for (int i = 0; i < 4; i++) {
+        uint32_t y = (quad[i].data1 >> 12) & 63;
+        bottom = std::min(bottom, y);
+        top = std::max(top, y);
+    }
+    return SideQuadSpan{ bottom, top - bottom };
+}
+
+// Merged quads stretch the AO of their corners, so only quads with the same AO at every corner are merged
+inline bool HasUniformAO(const ChunkMesher::ChunkVertex* quad) {
+    if (sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        uint32_t ao = (quad->data2 >> 11) & 255;
+        return ao == (ao & 3) * 0x55;
+    }
+    for (int i = 1; i < 4; i++) {
+        if (((quad[i].data1 ^ quad[0].data1) >> 18) & 3) return false;
+    }
+    return true;
+}
+
+// Whether two side face quads of the same slice line up across the chunk boundary and look the same. Quads of the
+// same face and AO are wound the same way, so their corners are in the same order
+inline bool SideQuadsMatch(const ChunkMesher::ChunkVertex* lower, const ChunkMesher::ChunkVertex* upper, int face) {
+    if (sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        uint32_t vertical = face < 2 ? (63u << 6) | (63u << 24) : 63u | (63u << 18);
+        return ((lower->data1 ^ upper->data1) & ~vertical) == 0 && lower->data2 == upper->data2;
+    }
+    for (int i = 0; i < 4; i++) {
+        if ((lower[i].data1 ^ upper[i].data1) & ~(63u << 12)) return false;
+        if ((lower[i].data2 ^ upper[i].data2) & ~(63u << 6)) return false;
+    }
+    return true;
+}
+
+// Merged quads can be taller than a chunk, the 2 bits above each 6 bit extent are kept in the free bits of data2
+constexpr uint32_t MAX_STACK_QUAD_EXTENT = 255;
+
+// How the quads of the chunk meshes are joined into a stack mesh
+struct StackQuadLink {
+    int32_t above = -1; // First vertex of the quad in the chunk above that continues this one
+    bool mergedBelow = false; // Continues a quad in the chunk below, which draws it
+    uint32_t height = 0; // Height from the bottom of the merged quad to the top of this one
+};
+
+// A merged quad starts as its bottom quad and ends at the top of its top quad
+inline void InsertMergedSideQuad(std::vector<ChunkMesher::ChunkVertex>& vertices, const ChunkMesher::ChunkVertex* bottom, uint32_t bottomIndex,
+    const ChunkMesher::ChunkVertex* top, uint32_t topIndex, uint32_t height, int face, int stream) {
+    if (sMeshFormat == ChunkMesher::MeshFormat::QUAD_INSTANCES) {
+        ChunkMesher::ChunkVertex quad = *bottom;
+        if (face < 2) {
+            quad.data1 = (quad.data1 & ~(63u << 24)) | ((height & 63) << 24);
+            quad.data2 |= (height >> 6) << 23;
+        }
+        else {
+            quad.data1 = (quad.data1 & ~(63u << 18)) | ((height & 63) << 18);
+            quad.data2 |= (height >> 6) << 21;
+        }
+        vertices.push_back(SetStackIndex(quad, stream, bottomIndex));
+        return;
+    }
+
+    // Bottom corners are the only ones with texture coordinates, which grow to cover the whole quad
+    SideQuadSpan bottomSpan = GetSideQuadSpan(bottom, face);
+    for (int i = 0; i < 4; i++) {
+        if (((bottom[i].data1 >> 12) & 63) == bottomSpan.bottom) {
+            ChunkMesher::ChunkVertex vertex = bottom[i];
+            vertex.data2 = (vertex.data2 & ~(63u << 6)) | ((height & 63) << 6) | ((height >> 6) << 24);
+            vertices.push_back(SetStackIndex(vertex, stream, bottomIndex));
+        }
+        else {
+            vertices.push_back(SetStackIndex(top[i], stream, topIndex));
+        }
+    }
+}
+
+// Links side quads that touch across each chunk boundary, bottom first so a merged quad keeps growing upwards
+static void FindStackMerges(const std::vector<ChunkMesher::ChunkMesh>& chunkMeshes, int stream, std::vector<std::vector<StackQuadLink>>& links) {
+    uint32_t quadVertices = GetStreamQuadVertices(stream);
+    for (std::size_t chunk = 0; chunk + 1 < chunkMeshes.size(); chunk++) {
+        const ChunkMesher::MeshStream& lower = chunkMeshes[chunk][stream];
+        const ChunkMesher::MeshStream& upper = chunkMeshes[chunk + 1][stream];
+        for (int face = 0; face < 4; face++) {
+            for (int layer = 1; layer < ChunkMesher::SLICE_LAYERS - 1; layer++) {
+                int slice = (face * ChunkMesher::SLICE_LAYERS) + layer;
+                for (uint32_t l = lower.sliceOffsets[slice]; l < lower.sliceOffsets[slice + 1]; l += quadVertices) {
+                    StackQuadLink& lowerLink = links[chunk][l / quadVertices];
+                    const ChunkMesher::ChunkVertex* lowerQuad = &lower.vertices[l];
+                    SideQuadSpan lowerSpan = GetSideQuadSpan(lowerQuad, face);
+                    if (!lowerLink.mergedBelow) {
+                        lowerLink.height = lowerSpan.height;
                     }
-                    case 5: {
-                        TextureID texZ = blockData.faces[BOTTOM_FACE];
-                        v1 = GetChunkVertex(mesh_back, mesh_left, mesh_up, ao_LB, 0, mesh_right - mesh_left, texZ, face, isGrass);
-                        v2 = GetChunkVertex(mesh_front, mesh_left, mesh_up, ao_LF, mesh_back - mesh_front, mesh_right - mesh_left, texZ, face, isGrass);
-                        v3 = GetChunkVertex(mesh_front, mesh_right, mesh_up, ao_RF, mesh_back - mesh_front, 0, texZ, face, isGrass);
-                        v4 = GetChunkVertex(mesh_back, mesh_right, mesh_up, ao_RB, 0, 0, texZ, face, isGrass);
+                    if (lowerSpan.bottom + lowerSpan.height != Chunk::SIZE || !HasUniformAO(lowerQuad)) continue;
+
+                    for (uint32_t u = upper.sliceOffsets[slice]; u < upper.sliceOffsets[slice + 1]; u += quadVertices) {
+                        StackQuadLink& upperLink = links[chunk + 1][u / quadVertices];
+                        const ChunkMesher::ChunkVertex* upperQuad = &upper.vertices[u];
+                        SideQuadSpan upperSpan = GetSideQuadSpan(upperQuad, face);
+                        if (upperLink.mergedBelow || upperSpan.bottom != 0 || lowerLink.height + upperSpan.height > MAX_STACK_QUAD_EXTENT) continue;
+                        if (!SideQuadsMatch(lowerQuad, upperQuad, face)) continue;
+
+                        lowerLink.above = static_cast<int32_t>(u);
+                        upperLink.mergedBelow = true;
+                        upperLink.height = lowerLink.height + upperSpan.height;
                         break;
                     }
-                    }
-                    bool flipped = ao_LB + ao_RF > ao_RB + ao_LF;
-                    InsertQuad(vertices, v1, v2, v3, v4, !flipped);
                 }
             }
         }
     }
 }
 
-ChunkMesher::ChunkVertex GetCustomModelBlockVertex(uint32_t x, uint32_t y, uint32_t z, uint32_t texX, uint32_t texY, uint32_t type, bool isFoliage) {
-    return {
-        ((z) << 20) | ((y) << 10) | (x),
-        (isFoliage << 18) | (type << 10) | (texY << 5) | (texX)
-    };
-}
+void ChunkMesher::MergeStackMeshes(const std::vector<ChunkMesh>& chunkMeshes, ChunkMesh& stackMesh) {
+    thread_local std::vector<std::vector<StackQuadLink>> links;
+    links.resize(chunkMeshes.size());
+
+    for (int stream = 0; stream < NUM_MESH_STREAMS; stream++) {
+        uint32_t quadVertices = GetStreamQuadVertices(stream);
+        std::size_t vertexCount = 0;
+        for (std::size_t chunk = 0; chunk < chunkMeshes.size(); chunk++) {
+            vertexCount += chunkMeshes[chunk][stream].vertices.size();
+            links[chunk].assign(chunkMeshes[chunk][stream].vertices.size() / quadVertices, StackQuadLink{});
+        }
+        // Custom models have no side faces to merge
+        if (stream != CUSTOM_MODEL_STREAM) {
+            FindStackMerges(chunkMeshes, stream, links);
+        }
 
-void ChunkMesher::MeshCustomModelBlocks(std::vector<ChunkVertex>& vertices, const std::vector<Block>& blocks) {
-    for (int x = 1; x < Chunk::SIZE_PADDED_SUB_1; x++) {
-        for (int y = 1; y < Chunk::SIZE_PADDED_SUB_1; y++) {
-            for (int z = 1; z < Chunk::SIZE_PADDED_SUB_1; z++) {
-                BlockType type = blocks[VoxelIndex(glm::ivec3( x, y, z ))].GetType();
-                BlockDataStruct blockData = GetBlockData(type);
-                if (blockData.modelID != static_cast<ModelID>(Model::CUBE)) {
-                    if (
-                        !GetBlockData(blocks[VoxelIndex(glm::ivec3( x + 1, y, z ))].GetType()).opaque ||
-                        !GetBlockData(blocks[VoxelIndex(glm::ivec3( x - 1, y, z ))].GetType()).opaque ||
-                        !GetBlockData(blocks[VoxelIndex(glm::ivec3( x, y + 1, z ))].GetType()).opaque ||
-                        !GetBlockData(blocks[VoxelIndex(glm::ivec3( x, y - 1, z ))].GetType()).opaque ||
-                        !GetBlockData(blocks[VoxelIndex(glm::ivec3( x, y, z + 1 ))].GetType()).opaque ||
-                        !GetBlockData(blocks[VoxelIndex(glm::ivec3( x, y, z - 1 ))].GetType()).opaque
-                        ) {
-                        std::vector<uint32_t>& modelVertices = BlockModels[blockData.modelID];
-                        std::vector<ChunkVertex> modelPackedVerts;
-                        for (int i = 0; i < modelVertices.size() - 1; i += 7) {
-                            modelPackedVerts.push_back(GetCustomModelBlockVertex(
-                                modelVertices[i] + ((x - 1) * 16),
-                                modelVertices[i + 1] + ((y - 1) * 16),
-                                modelVertices[i + 2] + ((z - 1) * 16),
-                                modelVertices[i + 3],
-                                modelVertices[i + 4],
-                                blockData.faces[TOP_FACE],
-                                type == BlockType::TALL_GRASS
-                            ));
+        MeshStream& out = stackMesh[stream];
+        out.vertices.clear();
+        out.vertices.reserve(vertexCount);
+        for (int slice = 0; slice < NUM_SLICES; slice++) {
+            out.sliceOffsets[slice] = static_cast<uint32_t>(out.vertices.size());
+            for (std::size_t chunk = 0; chunk < chunkMeshes.size(); chunk++) {
+                const MeshStream& in = chunkMeshes[chunk][stream];
+                for (uint32_t v = in.sliceOffsets[slice]; v < in.sliceOffsets[slice + 1]; v += quadVertices) {
+                    const StackQuadLink& link = links[chunk][v / quadVertices];
+                    if (link.mergedBelow) continue;
+                    if (link.above < 0) {
+                        for (uint32_t i = 0; i < quadVertices; i++) {
+                            out.vertices.push_back(SetStackIndex(in.vertices[v + i], stream, static_cast<uint32_t>(chunk)));
                         }
-                        vertices.insert(vertices.end(), modelPackedVerts.begin(), modelPackedVerts.end());
+                        continue;
                     }
+
+                    // Follow the merged quad up to its top
+                    std::size_t topChunk = chunk + 1;
+                    uint32_t top = static_cast<uint32_t>(link.above);
+                    while (links[topChunk][top / quadVertices].above >= 0) {
+                        top = static_cast<uint32_t>(links[topChunk][top / quadVertices].above);
+                        topChunk++;
+                    }
+                    InsertMergedSideQuad(out.vertices, &in.vertices[v], static_cast<uint32_t>(chunk), &chunkMeshes[topChunk][stream].vertices[top],
+                        static_cast<uint32_t>(topChunk), links[topChunk][top / quadVertices].height, slice / SLICE_LAYERS, stream);
                 }
             }
         }
+        out.sliceOffsets[NUM_SLICES] = static_cast<uint32_t>(out.vertices.size());
     }
 }
 
+// Recycled output buffers, capped so that a burst of remeshes can't hold on to memory forever
+constexpr std::size_t MAX_POOLED_VERTEX_BUFFERS = 64;
+constexpr std::size_t INITIAL_VERTEX_BUFFER_CAPACITY = 16384;
+static std::mutex sVertexBufferPoolMutex;
+static std::vector<std::vector<ChunkMesher::ChunkVertex>> sVertexBufferPool;
+
+std::vector<ChunkMesher::ChunkVertex> ChunkMesher::AcquireVertexBuffer() {
+    {
+        std::lock_guard<std::mutex> lock(sVertexBufferPoolMutex);
+        if (!sVertexBufferPool.empty()) {
+            std::vector<ChunkVertex> buffer = std::move(sVertexBufferPool.back());
+            sVertexBufferPool.pop_back();
+            return buffer;
+        }
+    }
+    std::vector<ChunkVertex> buffer;
+    buffer.reserve(INITIAL_VERTEX_BUFFER_CAPACITY);
+    sAllocations++;
+    return buffer;
+}
+
+void ChunkMesher::ReleaseVertexBuffer(std::vector<ChunkVertex>& buffer) {
+    if (buffer.capacity() == 0) return;
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(sVertexBufferPoolMutex);
+    if (sVertexBufferPool.size() < MAX_POOLED_VERTEX_BUFFERS) {
+        sVertexBufferPool.push_back(std::move(buffer));
+    }
+    std::vector<ChunkVertex>().swap(buffer);
+}
+
+std::size_t ChunkMesher::GetAllocationCount() {
+    return sAllocations.load();
+}
+
 /*
 MIT License
 
@@ -6,26 +6,130 @@ License: MIT
 #ifndef CHUNK_MESHER_H
 #define CHUNK_MESHER_H
 
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <world/Block.hpp>
-#include <functional>
+
+namespace BS {
+    class thread_pool;
+}
 
 namespace ChunkMesher {
-    typedef bool (*ChunkMeshFilterCallback)(Block);
+    // Materials built by the greedy mesher, each from its own set of column masks
+    enum MeshMaterial {
+        OPAQUE_MATERIAL,
+        GLASS_MATERIAL,
+        WATER_MATERIAL,
+        NUM_MESH_MATERIALS
+    };
 
+    // In the QUAD_INSTANCES format a ChunkVertex holds a whole greedy quad rather than one of its corners
     struct ChunkVertex {
         uint32_t data1;
         uint32_t data2;
     };
 
-    inline bool IsOpaqueCube(Block block) {
-        BlockDataStruct blockData = GetBlockData(block.GetType());
-        return blockData.opaque && blockData.modelID == static_cast<ModelID>(Model::CUBE);
-    }
+    // How the greedy mesher encodes quads, chosen once at startup before any chunk is meshed
+    enum class MeshFormat {
+        VERTICES, // 4 vertices per quad, drawn through the shared quad index buffer
+        QUAD_INSTANCES // 1 record per quad, expanded into 6 vertices by the quad shaders with an instanced draw
+    };
+
+    void SetMeshFormat(MeshFormat format);
+    MeshFormat GetMeshFormat();
+
+    // Voxels are classified into the mesh materials, whether they are solid, which AO and custom model
+    // culling are sampled from, and whether they have a custom model
+    constexpr int SOLID_CLASS = NUM_MESH_MATERIALS;
+    constexpr int CUSTOM_MODEL_CLASS = NUM_MESH_MATERIALS + 1;
+    constexpr int NUM_VOXEL_CLASSES = NUM_MESH_MATERIALS + 2;
+    constexpr uint32_t ALL_VOXEL_CLASSES = (1 << NUM_VOXEL_CLASSES) - 1;
+    // Opacity is always classified, the padding's is sampled for AO and culling whatever the chunk holds
+    constexpr uint32_t CUBE_CLASSES = (1 << OPAQUE_MATERIAL) | (1 << SOLID_CLASS);
+
+    // Voxel classes, as a mask, of the blocks counted in a histogram
+    uint32_t GetHistogramClasses(const BlockHistogram& histogram);
+
+    // Whole chunks are classified with an AVX2 kernel when the CPU has it, which can be turned off to compare
+    // against the scalar classification
+    bool IsSIMDClassifySupported();
+    void SetSIMDClassifyEnabled(bool enabled);
+    bool IsSIMDClassifyEnabled();
+
+    // Running totals of BinaryGreedyMesh calls for profiling from the debug menu
+    struct MeshTimings {
+        std::size_t calls;
+        double totalMicroseconds;
+    };
+
+    MeshTimings GetMeshTimings();
+    void ResetMeshTimings();
+
+    // Output buffers are recycled between remeshes so their capacity is reused instead of regrown from empty
+    std::vector<ChunkVertex> AcquireVertexBuffer();
+    // Return a buffer to the pool, leaving it empty
+    void ReleaseVertexBuffer(std::vector<ChunkVertex>& buffer);
+    // Heap allocations made by the mesher for scratch space and output buffers since startup
+    std::size_t GetAllocationCount();
+
+    // Quads are grouped into slices, one per face and layer of the padded chunk, so that an edit only has to
+    // remesh the slices it can affect. Custom models belong to the +y slice of their layer
+    constexpr int SLICE_LAYERS = 64; // Chunk::SIZE_PADDED
+    constexpr int NUM_SLICES = 6 * SLICE_LAYERS;
+    constexpr int CUSTOM_MODEL_SLICE_FACE = 4;
+
+    // Offset of the first vertex of every slice followed by the end of the last slice
+    using SliceOffsets = std::array<uint32_t, NUM_SLICES + 1>;
+    // A set of slices as a mask over the layers of each face
+    using SliceMask = std::array<uint64_t, 6>;
+    inline constexpr SliceMask ALL_SLICES = { ~0ULL, ~0ULL, ~0ULL, ~0ULL, ~0ULL, ~0ULL };
+
+    // Slices whose quads can change when the block at a position in the chunk does: the planes through the
+    // block and the planes either side of them, which hold its neighbours' faces and sample it for AO
+    SliceMask GetBlockSlices(int x, int y, int z);
+
+    // Vertices of one stream sorted by slice
+    struct MeshStream {
+        std::vector<ChunkVertex> vertices;
+        SliceOffsets sliceOffsets{};
+    };
+
+    // Opaque cubes and glass, water and custom models are each drawn with their own shader
+    enum MeshStreamID {
+        OPAQUE_STREAM,
+        WATER_STREAM,
+        CUSTOM_MODEL_STREAM,
+        NUM_MESH_STREAMS
+    };
+
+    using ChunkMesh = std::array<MeshStream, NUM_MESH_STREAMS>;
+
+    // Meshes the given slices of a chunk, classifying the blocks in a single pass. Only the layers the slices
+    // depend on are classified when remeshing a few slices, and the streams hold just those slices. chunkClasses
+    // are the classes of the blocks inside the chunk, the passes for materials it doesn't hold are skipped. Given a
+    // pool, every face direction of every material and the custom models are meshed as separate tasks on it, for a
+    // single chunk that is wanted as soon as possible. The mesh is the same either way
+    void BinaryGreedyMesh(ChunkMesh& mesh, const std::vector<Block>& blocks, const SliceMask& slices = ALL_SLICES, uint32_t chunkClasses = ALL_VOXEL_CLASSES, BS::thread_pool* pool = nullptr);
+
+    // Quads in a mesh, counting custom model faces
+    std::size_t GetQuadCount(const ChunkMesh& mesh);
+
+    // Replaces every cell of scale blocks a side, a power of two, starting from the chunk's first block, with one
+    // block type, so the greedy mesher merges each cell into a few quads. Cells are solid, taking the type of their
+    // highest solid block, when at least half of them is solid, else water when at least half is water or solid.
+    // Custom models are left out. The padding is left as air so the chunk closes its own volume, its boundary faces
+    // standing in as skirts wherever its neighbours are at another level of detail
+    void DownsampleBlocks(const std::vector<Block>& blocks, int scale, std::vector<Block>& lodBlocks);
+
+    // A stack mesh draws the chunks of a stack with one model matrix, every vertex recording which chunk it
+    // belongs to in bits the formats leave free
+    constexpr int MAX_STACK_CHUNKS = 4;
 
-    void BinaryGreedyMesh(std::vector<ChunkVertex>& vertices, const std::vector<Block>& blocks, ChunkMeshFilterCallback condition);
-    void MeshCustomModelBlocks(std::vector<ChunkVertex>& vertices, const std::vector<Block>& blocks);
+    // Joins the meshes of vertically adjacent chunks, bottom first, into a stack mesh. Side faces that meet at the
+    // boundaries between chunks are merged into one quad when they line up and have the same block and uniform AO.
+    // The stack mesh keeps the slice order of the chunk meshes
+    void MergeStackMeshes(const std::vector<ChunkMesh>& chunkMeshes, ChunkMesh& stackMesh);
 };
 
 #endif // !CHUNK_MESHER_H
@@ -7,15 +7,48 @@ LICENSE: MIT
 #include <world/World.hpp>
 #include <world/Block.hpp>
 #include <util/Log.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <random>
 #include <fstream>
 #include <filesystem>
 
-ChunkStack::ChunkStack(glm::ivec2 pos) : mPos(pos)
+// Dense block buffer per thread used to convert between the on disk format and paletted chunk storage
+static std::vector<Block>& GetBlockBuffer() {
+    thread_local std::vector<Block> blocks(Chunk::SIZE_PADDED_CUBED, Block(BlockType::AIR, 0, false));
+    return blocks;
+}
+
+bool ChunkStack::sStackMeshing = false;
+
+void ChunkStack::SetStackMeshing(bool stackMeshing)
+{
+    sStackMeshing = stackMeshing;
+}
+
+bool ChunkStack::IsStackMeshing()
+{
+    return sStackMeshing;
+}
+
+ChunkStack::ChunkStack(glm::ivec2 pos) : mPos(pos), mChunkMeshes(DEFAULT_SIZE)
 {
     for (int y = 0; y < ChunkStack::DEFAULT_SIZE; y++) {
         mChunks.emplace_back(std::make_shared<Chunk>(glm::ivec3(pos.x, y, pos.y)));
     }
+    for (std::size_t y = 1; y < mChunks.size(); y++) {
+        mChunks[y]->SetNeighbour(NEGATIVE_FACES[1], mChunks[y - 1].get());
+        mChunks[y - 1]->SetNeighbour(POSITIVE_FACES[1], mChunks[y].get());
+    }
+
+    // Setup stack buffers, laid out like the chunks' own
+    VertexBufferLayout bufferLayout;
+    bufferLayout.AddAttribute<unsigned int>(2);
+    mVAO.AddBuffer(mVBO.GetBuffer(), GetGreedyQuadLayout());
+    mWaterVAO.AddBuffer(mWaterVBO.GetBuffer(), GetGreedyQuadLayout());
+    mCustomModelVAO.AddBuffer(mCustomModelVBO.GetBuffer(), bufferLayout);
+
+    // The stack mesh is positioned from its bottom chunk
+    mModel = glm::translate(mModel, glm::vec3(static_cast<float>(pos.x * Chunk::SIZE), 0.0f, static_cast<float>(pos.y * Chunk::SIZE)));
 }
 
 ChunkStack::iterator ChunkStack::begin() {
@@ -130,30 +163,134 @@ glm::ivec2 ChunkStack::GetPosition() const
     return mPos;
 }
 
-void ChunkStack::Draw(Shader& shader, int* totalChunks, int* chunksDrawn)
+bool ChunkStack::NeedsBuffering() const
 {
-    for (auto& chunk : mChunks) {
-        chunk->Draw(shader, totalChunks, chunksDrawn);
+    for (const auto& chunk : mChunks) {
+        if (chunk->needsBuffering) return true;
     }
+    return false;
 }
 
-void ChunkStack::DrawWater(Shader& shader, int* totalChunks, int* chunksDrawn)
+void ChunkStack::BufferData()
 {
-    for (auto& chunk : mChunks) {
-        chunk->DrawWater(shader, totalChunks, chunksDrawn);
+    if (!sStackMeshing) {
+        for (auto& chunk : mChunks) {
+            chunk->BufferData();
+        }
+        return;
+    }
+
+    // Chunks are still meshed one at a time, the stack mesh is rebuilt from their latest meshes whenever one changes
+    bool changed = false;
+    for (std::size_t i = 0; i < mChunks.size(); i++) {
+        changed |= mChunks[i]->TakeMesh(mChunkMeshes[i]);
+    }
+    if (!changed) return;
+
+    ChunkMesher::ChunkMesh stackMesh;
+    for (ChunkMesher::MeshStream& stream : stackMesh) {
+        stream.vertices = ChunkMesher::AcquireVertexBuffer();
+    }
+    ChunkMesher::MergeStackMeshes(mChunkMeshes, stackMesh);
+
+    std::array<SlicedVertexBuffer*, ChunkMesher::NUM_MESH_STREAMS> buffers = { &mVBO, &mWaterVBO, &mCustomModelVBO };
+    for (int stream = 0; stream < ChunkMesher::NUM_MESH_STREAMS; stream++) {
+        buffers[stream]->Upload(stackMesh[stream]);
+    }
+
+    mChunkQuads = 0;
+    for (const ChunkMesher::ChunkMesh& mesh : mChunkMeshes) {
+        mChunkQuads += ChunkMesher::GetQuadCount(mesh);
+    }
+    mStackQuads = ChunkMesher::GetQuadCount(stackMesh);
+    for (ChunkMesher::MeshStream& stream : stackMesh) {
+        ChunkMesher::ReleaseVertexBuffer(stream.vertices);
     }
 }
 
-void ChunkStack::DrawCustomModel(Shader& shader, int* totalChunks, int* chunksDrawn)
+std::size_t ChunkStack::GetStackQuadCount() const
 {
-    for (auto& chunk : mChunks) {
-        chunk->DrawCustomModel(shader, totalChunks, chunksDrawn);
+    return mStackQuads;
+}
+
+std::size_t ChunkStack::GetChunkQuadCount() const
+{
+    return mChunkQuads;
+}
+
+void ChunkStack::UpdateCameraFacingFaces(glm::vec3 cameraPos)
+{
+    glm::vec3 boxMin(static_cast<float>(mPos.x * Chunk::SIZE), 0.0f, static_cast<float>(mPos.y * Chunk::SIZE));
+    glm::vec3 boxMax = boxMin + glm::vec3(static_cast<float>(Chunk::SIZE), static_cast<float>(mChunks.size() * Chunk::SIZE), static_cast<float>(Chunk::SIZE));
+    mCameraFacingFaces = GetCameraFacingFaces(boxMin, boxMax, cameraPos);
+}
+
+bool ChunkStack::IsAnyChunkVisible() const
+{
+    for (const auto& chunk : mChunks) {
+        if (chunk->visible) return true;
     }
+    return false;
+}
+
+void ChunkStack::Draw(Shader& shader, QuadElementBuffer& quadIndices, int* totalChunks, int* chunksDrawn)
+{
+    if (!sStackMeshing) {
+        for (auto& chunk : mChunks) {
+            chunk->Draw(shader, quadIndices, totalChunks, chunksDrawn);
+        }
+        return;
+    }
+
+    if (totalChunks) (*totalChunks)++;
+    if (mVBO.GetVertexCount() == 0 || !IsAnyChunkVisible()) return;
+    if (chunksDrawn) (*chunksDrawn)++;
+    shader.SetMat4("model", mModel);
+    DrawGreedyQuads(mVAO, mVBO, quadIndices, mCameraFacingFaces);
+}
+
+void ChunkStack::DrawWater(Shader& shader, QuadElementBuffer& quadIndices, int* totalChunks, int* chunksDrawn)
+{
+    if (!sStackMeshing) {
+        for (auto& chunk : mChunks) {
+            chunk->DrawWater(shader, quadIndices, totalChunks, chunksDrawn);
+        }
+        return;
+    }
+
+    if (totalChunks) (*totalChunks)++;
+    if (mWaterVBO.GetVertexCount() == 0 || !IsAnyChunkVisible()) return;
+    if (chunksDrawn) (*chunksDrawn)++;
+    shader.SetMat4("model", mModel);
+    DrawGreedyQuads(mWaterVAO, mWaterVBO, quadIndices, mCameraFacingFaces);
+}
+
+void ChunkStack::DrawCustomModel(Shader& shader, QuadElementBuffer& quadIndices, int* totalChunks, int* chunksDrawn)
+{
+    if (!sStackMeshing) {
+        for (auto& chunk : mChunks) {
+            chunk->DrawCustomModel(shader, quadIndices, totalChunks, chunksDrawn);
+        }
+        return;
+    }
+
+    if (totalChunks) (*totalChunks)++;
+    if (mCustomModelVBO.GetVertexCount() == 0 || !IsAnyChunkVisible()) return;
+    if (chunksDrawn) (*chunksDrawn)++;
+    mCustomModelVAO.Bind();
+    shader.SetMat4("model", mModel);
+    quadIndices.Draw(mCustomModelVBO.GetVertexCount() / QuadElementBuffer::VERTICES_PER_QUAD);
 }
 
 void ChunkStack::FullyLoad(const std::string& worldDirectory, siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin) {
     if (state == ChunkStackState::PARTIALLY_LOADED) {
         GenerateTerrain(seed, perlin);
+        // The mesh from a partial load is only kept when it was at full detail
+        if (mLodScale != 1) {
+            for (auto& chunk : mChunks) {
+                chunk->CreateMesh();
+            }
+        }
     } 
     else {
         std::ifstream chunkStackFileStream(fmt::format("{}/chunk_stacks/{}.{}.stack", worldDirectory, mPos.x, mPos.y));
@@ -163,9 +300,10 @@ void ChunkStack::FullyLoad(const std::string& worldDirectory, siv::PerlinNoise::
             std::size_t chunkCount;
             chunkStackFileStream.read(reinterpret_cast<char*>(&chunkCount), sizeof(std::size_t));
 
+            std::vector<Block>& blocks = GetBlockBuffer();
             for (std::size_t i = 0; i < chunkCount; i++) {
-                mChunks[i]->AllocateMemory();
-                chunkStackFileStream.read(reinterpret_cast<char*>(mChunks[i]->GetBlockDataPointer()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
+                chunkStackFileStream.read(reinterpret_cast<char*>(blocks.data()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
+                mChunks[i]->EncodeBlocks(blocks.data());
             }
 
         }
@@ -181,13 +319,24 @@ void ChunkStack::FullyLoad(const std::string& worldDirectory, siv::PerlinNoise::
             chunk->CreateMesh();
         }
     }
+    mLodScale = 1;
+    for (auto& chunk : mChunks) {
+        chunk->loaded = true;
+    }
     state = ChunkStackState::LOADED;
 }
 
-void ChunkStack::PartiallyLoad(const std::string& worldDirectory, siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin) {
+void ChunkStack::PartiallyLoad(const std::string& worldDirectory, siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin, int lodScale) {
     if (state == ChunkStackState::LOADED) {
+        for (auto& chunk : mChunks) {
+            chunk->loaded = false;
+        }
         SaveToFile(worldDirectory);
+        // A full detail mesh is still current, a lower level of detail is meshed before the blocks go
         for (auto& chunk : mChunks) {
+            if (lodScale != 1) {
+                chunk->CreateLodMesh(lodScale);
+            }
             chunk->ReleaseMemory();
         }
     }
@@ -199,9 +348,10 @@ void ChunkStack::PartiallyLoad(const std::string& worldDirectory, siv::PerlinNoi
             std::size_t chunkCount;
             chunkStackFileStream.read(reinterpret_cast<char*>(&chunkCount), sizeof(std::size_t));
 
+            std::vector<Block>& blocks = GetBlockBuffer();
             for (std::size_t i = 0; i < chunkCount; i++) {
-                mChunks[i]->AllocateMemory();
-                chunkStackFileStream.read(reinterpret_cast<char*>(mChunks[i]->GetBlockDataPointer()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
+                chunkStackFileStream.read(reinterpret_cast<char*>(blocks.data()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
+                mChunks[i]->EncodeBlocks(blocks.data());
             }
 
         }
@@ -213,17 +363,29 @@ void ChunkStack::PartiallyLoad(const std::string& worldDirectory, siv::PerlinNoi
 
         // Mesh all chunks
         for (auto& chunk: mChunks) {
-            chunk->CreateMesh();
+            if (lodScale != 1) {
+                chunk->CreateLodMesh(lodScale);
+            }
+            else {
+                chunk->CreateMesh();
+            }
             chunk->ReleaseMemory();
         }
     }
+    mLodScale = lodScale;
     state = ChunkStackState::PARTIALLY_LOADED;
 }
 
+int ChunkStack::GetLodScale() const
+{
+    return mLodScale;
+}
+
 void ChunkStack::Unload(const std::string& worldDirectory) {
     if (state == ChunkStackState::LOADED) {
         SaveToFile(worldDirectory);
         for (auto& chunk : mChunks) {
+            chunk->loaded = false;
             chunk->needsBuffering = false;
             chunk->ReleaseMemory();
         }
@@ -236,12 +398,15 @@ void ChunkStack::SaveToFile(const std::string& worldDirectory) {
     std::fstream out(file, std::ios::binary | std::ios::out | std::ios::in);
     std::size_t chunkCount = mChunks.size();
 
+    std::vector<Block>& blocks = GetBlockBuffer();
+
     if (out.is_open()) {
         out.write(reinterpret_cast<char*>(&chunkCount), sizeof(std::size_t));
         for (std::size_t i = 0; i < chunkCount; i++) {
             if (mChunks[i]->needsSaving) {
                 mChunks[i]->needsSaving = false;
-                out.write(reinterpret_cast<const char*>(mChunks[i]->GetBlockDataPointer()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
+                mChunks[i]->DecodeBlocks(blocks.data());
+                out.write(reinterpret_cast<const char*>(blocks.data()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
             }
             else {
                 out.seekp(sizeof(Block) * Chunk::SIZE_PADDED_CUBED, std::ios::cur);
@@ -254,7 +419,8 @@ void ChunkStack::SaveToFile(const std::string& worldDirectory) {
         out.write(reinterpret_cast<char*>(&chunkCount), sizeof(std::size_t));
         for (std::size_t i = 0; i < chunkCount; i++) {
             mChunks[i]->needsSaving = false;
-            out.write(reinterpret_cast<const char*>(mChunks[i]->GetBlockDataPointer()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
+            mChunks[i]->DecodeBlocks(blocks.data());
+            out.write(reinterpret_cast<const char*>(blocks.data()), sizeof(Block) * Chunk::SIZE_PADDED_CUBED);
         }
     }
 
@@ -293,6 +459,32 @@ std::shared_ptr<Chunk>ChunkStack::GetChunk(std::size_t y) const {
     }
 }
 
+Chunk* ChunkStack::GetChunkHandle(std::size_t y) const {
+    if (y >= mChunks.size()) {
+        return nullptr;
+    }
+    return mChunks[y].get();
+}
+
+void ChunkStack::LinkNeighbour(int face, ChunkStack* neighbour) {
+    // Opposite faces only differ in their lowest bit
+    int oppositeFace = face ^ 1;
+    for (std::size_t y = 0; y < mChunks.size(); y++) {
+        Chunk* chunk = mChunks[y].get();
+        if (neighbour != nullptr) {
+            Chunk* neighbourChunk = neighbour->GetChunkHandle(y);
+            chunk->SetNeighbour(face, neighbourChunk);
+            if (neighbourChunk != nullptr) {
+                neighbourChunk->SetNeighbour(oppositeFace, chunk);
+            }
+        }
+        else if (chunk->GetNeighbour(face) != nullptr) {
+            chunk->GetNeighbour(face)->SetNeighbour(oppositeFace, nullptr);
+            chunk->SetNeighbour(face, nullptr);
+        }
+    }
+}
+
 /*
 MIT License
 
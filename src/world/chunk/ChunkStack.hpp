@@ -8,10 +8,13 @@ LICENSE: MIT
 
 #include <vector>
 #include <world/chunk/Chunk.hpp>
+#include <world/chunk/ChunkMesher.hpp>
+#include <world/chunk/SlicedVertexBuffer.hpp>
 #include <world/Block.hpp>
 #include <opengl/Shader.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
 #include <math/Frustum.hpp>
 #include <PerlinNoise.hpp>
 #include <world/Block.hpp>
@@ -29,6 +32,23 @@ class ChunkStack {
 private:
     glm::ivec2 mPos{};
     std::vector<std::shared_ptr<Chunk>> mChunks;
+
+    // Stack meshing joins the meshes of the chunks into one set of buffers, drawn from the bottom chunk
+    static bool sStackMeshing;
+    VertexArray mVAO;
+    SlicedVertexBuffer mVBO;
+    VertexArray mWaterVAO;
+    SlicedVertexBuffer mWaterVBO;
+    VertexArray mCustomModelVAO;
+    SlicedVertexBuffer mCustomModelVBO;
+    glm::mat4 mModel = glm::mat4(1.0f);
+    // Latest mesh of every chunk, kept to rebuild the stack mesh when any of them changes
+    std::vector<ChunkMesher::ChunkMesh> mChunkMeshes;
+    std::size_t mChunkQuads = 0;
+    std::size_t mStackQuads = 0;
+    int mLodScale = 1; // Blocks per cell the chunks are meshed with
+    uint8_t mCameraFacingFaces = ALL_FACES;
+    bool IsAnyChunkVisible() const;
     void SaveToFile(const std::string& worldDirectory);
 public:
     using iterator = std::vector<std::shared_ptr<Chunk>>::iterator;
@@ -39,19 +59,39 @@ public:
     const_iterator cend() const;
     size_t size() const;
     static constexpr std::size_t DEFAULT_SIZE = 4;
+    static_assert(DEFAULT_SIZE <= ChunkMesher::MAX_STACK_CHUNKS);
+    // Whether stacks are meshed and drawn as a whole rather than chunk by chunk, chosen once at startup
+    static void SetStackMeshing(bool stackMeshing);
+    static bool IsStackMeshing();
     ChunkStack(glm::ivec2 pos);
     void GenerateTerrain(siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin);
-    void Draw(Shader& shader, int* totalChunks, int* chunksDrawn);
-    void DrawWater(Shader& shader, int* totalChunks, int* chunksDrawn);
-    void DrawCustomModel(Shader& shader, int* totalChunks, int* chunksDrawn);
+    void Draw(Shader& shader, QuadElementBuffer& quadIndices, int* totalChunks, int* chunksDrawn);
+    void DrawWater(Shader& shader, QuadElementBuffer& quadIndices, int* totalChunks, int* chunksDrawn);
+    void DrawCustomModel(Shader& shader, QuadElementBuffer& quadIndices, int* totalChunks, int* chunksDrawn);
+    // Find which faces of the stack mesh can face the camera
+    void UpdateCameraFacingFaces(glm::vec3 cameraPos);
+    // Whether any chunk has a new mesh to buffer
+    bool NeedsBuffering() const;
+    // Buffer the new meshes of the chunks, or rebuild the stack mesh from them when stack meshing
+    void BufferData();
+    // Quads of the stack mesh, and of the chunk meshes it was merged from
+    std::size_t GetStackQuadCount() const;
+    std::size_t GetChunkQuadCount() const;
     glm::ivec2 GetPosition() const;
     std::shared_ptr<Chunk> GetChunk(std::size_t y) const;
+    // Non-owning, stays valid for as long as the stack does
+    Chunk* GetChunkHandle(std::size_t y) const;
+    // Link each chunk to the chunk at its height in a neighbouring stack across face (one of the x or z faces), both
+    // ways round, or unlink them both ways given nullptr
+    void LinkNeighbour(int face, ChunkStack* neighbour);
     Block RawGetBlock(glm::ivec3 pos) const;
     void RawSetBlock(glm::ivec3 pos, Block block);
     Block GetBlock(glm::ivec3 pos) const;
     void SetBlock(glm::ivec3 pos, Block block);
     void FullyLoad(const std::string& worldDirectory, siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin);
-    void PartiallyLoad(const std::string& worldDirectory, siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin);
+    // Mesh the stack, at a lower level of detail for a lodScale above 1, then release its blocks
+    void PartiallyLoad(const std::string& worldDirectory, siv::PerlinNoise::seed_type seed, const siv::PerlinNoise& perlin, int lodScale = 1);
+    int GetLodScale() const;
     void Unload(const std::string& worldDirectory);;
     std::atomic<ChunkStackState> state = ChunkStackState::NOT_INITIALISED;
     std::atomic<bool> is_in_task = false;
@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#include <world/chunk/PalettedBlockStorage.hpp>
+#include <world/chunk/ChunkBufferPool.hpp>
+#include <algorithm>
+
+// Smallest supported index width able to address a palette of the given size
+static int GetBitsForPaletteSize(std::size_t paletteSize) {
+    if (paletteSize <= 1) return 0;
+    if (paletteSize <= 2) return 1;
+    if (paletteSize <= 4) return 2;
+    if (paletteSize <= 16) return 4;
+    if (paletteSize <= 256) return 8;
+    return 16;
+}
+
+template<int bits>
+static void DecodePacked(const uint64_t* data, std::size_t dataSize, const Block* palette, Block* out) {
+    constexpr int INDICES_PER_WORD = 64 / bits;
+    constexpr uint64_t MASK = (1ULL << bits) - 1;
+    for (std::size_t word = 0; word < dataSize; word++) {
+        uint64_t value = data[word];
+        Block* wordOut = out + word * INDICES_PER_WORD;
+        for (int i = 0; i < INDICES_PER_WORD; i++) {
+            wordOut[i] = palette[value & MASK];
+            value >>= bits;
+        }
+    }
+}
+
+// Pack indices produced by getIndex(i) into every word of data, so it never needs zeroing first
+template<typename F>
+static void PackIndices(uint64_t* data, std::size_t dataSize, int bitsPerIndex, F getIndex) {
+    std::size_t indicesPerWord = 64 / bitsPerIndex;
+    for (std::size_t word = 0; word < dataSize; word++) {
+        uint64_t value = 0;
+        std::size_t first = word * indicesPerWord;
+        for (std::size_t i = 0; i < indicesPerWord; i++) {
+            value |= static_cast<uint64_t>(getIndex(first + i)) << (i * bitsPerIndex);
+        }
+        data[word] = value;
+    }
+}
+
+PalettedBlockStorage::PalettedBlockStorage(std::size_t size) : mSize(size)
+{
+    Fill(Block(BlockType::AIR, 0, false));
+}
+
+PalettedBlockStorage::PalettedBlockStorage(const PalettedBlockStorage& other) :
+    mSize(other.mSize),
+    mBitsPerIndex(other.mBitsPerIndex),
+    mPalette(other.mPalette),
+    mPaletteRefCounts(other.mPaletteRefCounts),
+    mUsedPaletteEntries(other.mUsedPaletteEntries),
+    mData(other.AllocateData(other.mBitsPerIndex)),
+    mDataSize(other.mDataSize)
+{
+    std::copy_n(other.mData, mDataSize, mData);
+}
+
+PalettedBlockStorage::~PalettedBlockStorage()
+{
+    ChunkBufferPool::Free(mData, mDataSize * sizeof(uint64_t));
+}
+
+uint64_t* PalettedBlockStorage::AllocateData(int bitsPerIndex) const
+{
+    if (bitsPerIndex == 0) return nullptr;
+    return static_cast<uint64_t*>(ChunkBufferPool::Allocate((mSize * bitsPerIndex / 64) * sizeof(uint64_t)));
+}
+
+void PalettedBlockStorage::SetData(uint64_t* data, int bitsPerIndex)
+{
+    ChunkBufferPool::Free(mData, mDataSize * sizeof(uint64_t));
+    mData = data;
+    mDataSize = mSize * bitsPerIndex / 64;
+    mBitsPerIndex = bitsPerIndex;
+}
+
+uint32_t PalettedBlockStorage::GetIndex(std::size_t i) const
+{
+    std::size_t bitOffset = i * mBitsPerIndex;
+    return static_cast<uint32_t>((mData[bitOffset >> 6] >> (bitOffset & 63)) & ((1ULL << mBitsPerIndex) - 1));
+}
+
+void PalettedBlockStorage::SetIndex(std::size_t i, uint32_t paletteIndex)
+{
+    std::size_t bitOffset = i * mBitsPerIndex;
+    uint64_t& word = mData[bitOffset >> 6];
+    int shift = static_cast<int>(bitOffset & 63);
+    word = (word & ~(((1ULL << mBitsPerIndex) - 1) << shift)) | (static_cast<uint64_t>(paletteIndex) << shift);
+}
+
+uint32_t PalettedBlockStorage::GetOrInsertPaletteIndex(Block block)
+{
+    // Palettes are almost always tiny, so a linear search beats any hashing here
+    std::size_t freeEntry = mPalette.size();
+    for (std::size_t i = 0; i < mPalette.size(); i++) {
+        if (mPalette[i] == block) {
+            return static_cast<uint32_t>(i);
+        }
+        if (mPaletteRefCounts[i] == 0 && freeEntry == mPalette.size()) {
+            freeEntry = i;
+        }
+    }
+
+    // Reuse an entry no longer referenced by any block
+    if (freeEntry != mPalette.size()) {
+        mPalette[freeEntry] = block;
+        return static_cast<uint32_t>(freeEntry);
+    }
+
+    // Palette is full, widen the indices
+    if (mPalette.size() >= (1ULL << mBitsPerIndex)) {
+        Repack(mBitsPerIndex == 0 ? 1 : mBitsPerIndex * 2);
+    }
+    mPalette.push_back(block);
+    mPaletteRefCounts.push_back(0);
+    return static_cast<uint32_t>(mPalette.size() - 1);
+}
+
+void PalettedBlockStorage::Repack(int bitsPerIndex)
+{
+    uint64_t* data = AllocateData(bitsPerIndex);
+    std::size_t dataSize = mSize * bitsPerIndex / 64;
+    if (mBitsPerIndex == 0) {
+        std::fill(data, data + dataSize, 0);
+    }
+    else {
+        PackIndices(data, dataSize, bitsPerIndex, [this](std::size_t i) { return GetIndex(i); });
+    }
+    SetData(data, bitsPerIndex);
+}
+
+void PalettedBlockStorage::Fill(Block block)
+{
+    mPalette.assign(1, block);
+    mPaletteRefCounts.assign(1, static_cast<uint32_t>(mSize));
+    mUsedPaletteEntries = 1;
+    SetData(nullptr, 0);
+}
+
+Block PalettedBlockStorage::Get(std::size_t i) const
+{
+    if (mBitsPerIndex == 0) return mPalette[0];
+    return mPalette[GetIndex(i)];
+}
+
+void PalettedBlockStorage::Set(std::size_t i, Block block)
+{
+    uint32_t oldIndex = mBitsPerIndex == 0 ? 0 : GetIndex(i);
+    if (mPalette[oldIndex] == block) return;
+
+    uint32_t newIndex = GetOrInsertPaletteIndex(block);
+    SetIndex(i, newIndex);
+    if (mPaletteRefCounts[newIndex]++ == 0) {
+        mUsedPaletteEntries++;
+    }
+    if (--mPaletteRefCounts[oldIndex] == 0) {
+        mUsedPaletteEntries--;
+        // Shrink once the palette is mostly unused so we don't thrash between widths on repeated edits
+        if (mUsedPaletteEntries == 1 || mUsedPaletteEntries <= (1ULL << mBitsPerIndex) / 4) {
+            Compact();
+        }
+    }
+}
+
+void PalettedBlockStorage::Decode(Block* out) const
+{
+    switch (mBitsPerIndex) {
+    case 0: std::fill(out, out + mSize, mPalette[0]); break;
+    case 1: DecodePacked<1>(mData, mDataSize, mPalette.data(), out); break;
+    case 2: DecodePacked<2>(mData, mDataSize, mPalette.data(), out); break;
+    case 4: DecodePacked<4>(mData, mDataSize, mPalette.data(), out); break;
+    case 8: DecodePacked<8>(mData, mDataSize, mPalette.data(), out); break;
+    case 16: DecodePacked<16>(mData, mDataSize, mPalette.data(), out); break;
+    }
+}
+
+void PalettedBlockStorage::Encode(const Block* blocks)
+{
+    thread_local std::vector<uint16_t> indices;
+    indices.resize(mSize);
+
+    mPalette.clear();
+    mPaletteRefCounts.clear();
+
+    // Runs of identical blocks are very common, so remember the last lookup
+    Block lastBlock = blocks[0];
+    uint16_t lastIndex = 0;
+    mPalette.push_back(lastBlock);
+    mPaletteRefCounts.push_back(0);
+    for (std::size_t i = 0; i < mSize; i++) {
+        Block block = blocks[i];
+        if (block != lastBlock) {
+            auto find = std::find(mPalette.begin(), mPalette.end(), block);
+            if (find == mPalette.end()) {
+                mPalette.push_back(block);
+                mPaletteRefCounts.push_back(0);
+                find = mPalette.end() - 1;
+            }
+            lastBlock = block;
+            lastIndex = static_cast<uint16_t>(find - mPalette.begin());
+        }
+        indices[i] = lastIndex;
+        mPaletteRefCounts[lastIndex]++;
+    }
+    mUsedPaletteEntries = mPalette.size();
+
+    int bitsPerIndex = GetBitsForPaletteSize(mPalette.size());
+    uint64_t* data = AllocateData(bitsPerIndex);
+    if (bitsPerIndex != 0) {
+        PackIndices(data, mSize * bitsPerIndex / 64, bitsPerIndex, [](std::size_t i) { return indices[i]; });
+    }
+    SetData(data, bitsPerIndex);
+}
+
+void PalettedBlockStorage::Compact()
+{
+    int bitsPerIndex = GetBitsForPaletteSize(mUsedPaletteEntries);
+    if (mUsedPaletteEntries == mPalette.size() && bitsPerIndex == mBitsPerIndex) return;
+
+    // Move the used palette entries to the front, remembering where each one went
+    thread_local std::vector<uint32_t> remap;
+    remap.assign(mPalette.size(), 0);
+    std::size_t used = 0;
+    for (std::size_t i = 0; i < mPalette.size(); i++) {
+        if (mPaletteRefCounts[i] != 0) {
+            remap[i] = static_cast<uint32_t>(used);
+            mPalette[used] = mPalette[i];
+            mPaletteRefCounts[used] = mPaletteRefCounts[i];
+            used++;
+        }
+    }
+    mPalette.resize(used, mPalette[0]);
+    mPaletteRefCounts.resize(used);
+
+    uint64_t* data = AllocateData(bitsPerIndex);
+    if (bitsPerIndex != 0) {
+        PackIndices(data, mSize * bitsPerIndex / 64, bitsPerIndex, [this](std::size_t i) { return remap[GetIndex(i)]; });
+    }
+    SetData(data, bitsPerIndex);
+}
+
+bool PalettedBlockStorage::IsUniform() const
+{
+    return mBitsPerIndex == 0;
+}
+
+std::size_t PalettedBlockStorage::GetSize() const
+{
+    return mSize;
+}
+
+std::size_t PalettedBlockStorage::GetPaletteSize() const
+{
+    return mUsedPaletteEntries;
+}
+
+int PalettedBlockStorage::GetBitsPerIndex() const
+{
+    return mBitsPerIndex;
+}
+
+std::size_t PalettedBlockStorage::GetMemoryUsage() const
+{
+    return mDataSize * sizeof(uint64_t) + mPalette.capacity() * sizeof(Block) + mPaletteRefCounts.capacity() * sizeof(uint32_t);
+}
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
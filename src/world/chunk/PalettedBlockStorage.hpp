@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#ifndef PALETTED_BLOCK_STORAGE_H
+#define PALETTED_BLOCK_STORAGE_H
+
+#include <world/Block.hpp>
+#include <cstdint>
+#include <vector>
+
+/*
+Stores a fixed number of blocks as indices into a palette of the distinct blocks present.
+Indices are bit packed into 64 bit words using 0, 1, 2, 4, 8 or 16 bits per block depending on
+the palette size, so that no index ever straddles two words. With 0 bits the storage holds a single
+block value and allocates no index data at all. Index data comes from the ChunkBufferPool.
+*/
+class PalettedBlockStorage {
+private:
+    std::size_t mSize = 0;
+    int mBitsPerIndex = 0;
+    std::vector<Block> mPalette;
+    std::vector<uint32_t> mPaletteRefCounts;
+    std::size_t mUsedPaletteEntries = 0;
+    uint64_t* mData = nullptr;
+    std::size_t mDataSize = 0;
+    uint64_t* AllocateData(int bitsPerIndex) const;
+    void SetData(uint64_t* data, int bitsPerIndex);
+    uint32_t GetIndex(std::size_t i) const;
+    void SetIndex(std::size_t i, uint32_t paletteIndex);
+    uint32_t GetOrInsertPaletteIndex(Block block);
+    void Repack(int bitsPerIndex);
+public:
+    explicit PalettedBlockStorage(std::size_t size);
+    ~PalettedBlockStorage();
+    // Copies the index data into a buffer of its own
+    PalettedBlockStorage(const PalettedBlockStorage& other);
+    PalettedBlockStorage& operator=(const PalettedBlockStorage&) = delete;
+    // Set every block in the storage to one value, releasing the index data
+    void Fill(Block block);
+    Block Get(std::size_t i) const;
+    void Set(std::size_t i, Block block);
+    // Decode every block into a dense array of GetSize() blocks
+    void Decode(Block* out) const;
+    // Replace the contents with a dense array of GetSize() blocks, building a minimal palette
+    void Encode(const Block* blocks);
+    // Rebuild the palette without unused entries, shrinking the index width if possible
+    void Compact();
+    // True when every block holds the same value and no index data is allocated
+    bool IsUniform() const;
+    std::size_t GetSize() const;
+    std::size_t GetPaletteSize() const;
+    int GetBitsPerIndex() const;
+    // Approximate heap memory used by the palette and index data in bytes
+    std::size_t GetMemoryUsage() const;
+};
+
+#endif // !PALETTED_BLOCK_STORAGE_H
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
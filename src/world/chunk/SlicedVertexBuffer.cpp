@@ -0,0 +1,254 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#include <world/chunk/SlicedVertexBuffer.hpp>
+#include <opengl/QuadElementBuffer.hpp>
+#include <algorithm>
+#include <bit>
+
+// Spare space reserved after a full upload, so the first slices to grow don't force a full remesh
+constexpr uint32_t MIN_SPARE_VERTICES = 64 * QuadElementBuffer::VERTICES_PER_QUAD;
+
+// Ranges are kept in whole quads of the 4 vertex format, so a range never splits a quad
+inline uint32_t RoundUpToQuad(uint32_t vertices) {
+    constexpr uint32_t QUAD = QuadElementBuffer::VERTICES_PER_QUAD;
+    return (vertices + QUAD - 1) / QUAD * QUAD;
+}
+
+// Staging for the vertices and zero padding written by one upload, only used from the main thread
+static std::vector<ChunkMesher::ChunkVertex> sStaging;
+
+struct SliceWrite {
+    uint32_t offset;
+    std::size_t stagingOffset;
+    uint32_t size;
+};
+
+const VertexBuffer& SlicedVertexBuffer::GetBuffer() const
+{
+    return mVBO;
+}
+
+void SlicedVertexBuffer::Upload(const ChunkMesher::MeshStream& stream)
+{
+    uint32_t size = static_cast<uint32_t>(stream.vertices.size());
+    mLayout.freeRanges.clear();
+    mLayout.end = size;
+    for (int slice = 0; slice < ChunkMesher::NUM_SLICES; slice++) {
+        uint32_t offset = stream.sliceOffsets[slice];
+        uint32_t sliceSize = stream.sliceOffsets[slice + 1] - offset;
+        mLayout.slots[slice] = Slot{ offset, sliceSize, sliceSize };
+    }
+    for (int face = 0; face < 6; face++) {
+        uint32_t offset = stream.sliceOffsets[face * ChunkMesher::SLICE_LAYERS];
+        mFaceRanges[face] = Range{ offset, stream.sliceOffsets[(face + 1) * ChunkMesher::SLICE_LAYERS] - offset };
+    }
+    mSpareOffset = size;
+    UpdateFaceRanges();
+
+    // An empty stream keeps no buffer, its first slice forces a full remesh instead
+    if (size == 0) {
+        mCapacity = 0;
+        return;
+    }
+    mCapacity = RoundUpToQuad(size + std::max(size / 4, MIN_SPARE_VERTICES));
+    mVBO.BufferData(nullptr, mCapacity * sizeof(ChunkMesher::ChunkVertex), GL_STATIC_DRAW);
+    mVBO.BufferSubData(stream.vertices.data(), 0, size * sizeof(ChunkMesher::ChunkVertex));
+}
+
+bool SlicedVertexBuffer::AllocateSlot(Layout& layout, int face, uint32_t size, Slot& slot) const
+{
+    // Leave room for the slice to keep growing, as edits tend to repeat in the same place
+    uint32_t wanted = RoundUpToQuad(size + size / 2);
+    const Range& faceRange = mFaceRanges[face];
+    for (auto it = layout.freeRanges.begin(); it != layout.freeRanges.end(); ++it) {
+        if (it->size < size) continue;
+        // Only the face's own range or the spare space, so drawing a face never draws another's quads
+        bool ownFace = it->offset >= faceRange.offset && it->offset < faceRange.offset + faceRange.size;
+        if (!ownFace && it->offset < mSpareOffset) continue;
+        uint32_t capacity = std::min(it->size, wanted);
+        slot = Slot{ it->offset, size, capacity };
+        it->offset += capacity;
+        it->size -= capacity;
+        if (it->size == 0) {
+            layout.freeRanges.erase(it);
+        }
+        return true;
+    }
+
+    uint32_t spare = mCapacity - layout.end;
+    if (spare < size) {
+        return false;
+    }
+    uint32_t capacity = std::min(spare, wanted);
+    slot = Slot{ layout.end, size, capacity };
+    layout.end += capacity;
+    return true;
+}
+
+bool SlicedVertexBuffer::PlaceSlices(const ChunkMesher::MeshStream& stream, const ChunkMesher::SliceMask& slices, Layout& layout) const
+{
+    for (int face = 0; face < 6; face++) {
+        uint64_t layers = slices[face];
+        while (layers) {
+            int slice = (face * ChunkMesher::SLICE_LAYERS) + std::countr_zero(layers);
+            layers &= layers - 1;
+
+            Slot& slot = layout.slots[slice];
+            uint32_t size = stream.sliceOffsets[slice + 1] - stream.sliceOffsets[slice];
+            if (size <= slot.capacity) {
+                slot.size = size;
+                continue;
+            }
+            if (slot.capacity > 0) {
+                layout.freeRanges.push_back(Range{ slot.offset, slot.capacity });
+            }
+            if (!AllocateSlot(layout, face, size, slot)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool SlicedVertexBuffer::CanUploadSlices(const ChunkMesher::MeshStream& stream, const ChunkMesher::SliceMask& slices) const
+{
+    Layout layout = mLayout;
+    return PlaceSlices(stream, slices, layout);
+}
+
+bool SlicedVertexBuffer::UploadSlices(const ChunkMesher::MeshStream& stream, const ChunkMesher::SliceMask& slices)
+{
+    Layout layout = mLayout;
+    if (!PlaceSlices(stream, slices, layout)) {
+        return false;
+    }
+
+    // Stage every write first, the vacated ranges of moved slices must be zeroed before anything moves into them
+    sStaging.clear();
+    std::vector<SliceWrite> clears;
+    std::vector<SliceWrite> writes;
+    for (int face = 0; face < 6; face++) {
+        uint64_t layers = slices[face];
+        while (layers) {
+            int slice = (face * ChunkMesher::SLICE_LAYERS) + std::countr_zero(layers);
+            layers &= layers - 1;
+
+            const Slot& oldSlot = mLayout.slots[slice];
+            const Slot& newSlot = layout.slots[slice];
+            bool moved = oldSlot.offset != newSlot.offset || oldSlot.capacity != newSlot.capacity;
+            if (moved && oldSlot.size > 0) {
+                clears.push_back(SliceWrite{ oldSlot.offset, 0, oldSlot.size });
+            }
+
+            // In place only the vertices the slice used to have need clearing, a moved slice fills its whole range
+            uint32_t writeSize = moved ? newSlot.capacity : std::max(newSlot.size, oldSlot.size);
+            if (writeSize == 0) continue;
+            writes.push_back(SliceWrite{ newSlot.offset, sStaging.size(), writeSize });
+            auto first = stream.vertices.begin() + stream.sliceOffsets[slice];
+            sStaging.insert(sStaging.end(), first, first + newSlot.size);
+            sStaging.resize(sStaging.size() + (writeSize - newSlot.size), ChunkMesher::ChunkVertex{ 0, 0 });
+        }
+    }
+
+    uint32_t largestClear = 0;
+    for (const SliceWrite& clear : clears) {
+        largestClear = std::max(largestClear, clear.size);
+    }
+    std::vector<ChunkMesher::ChunkVertex> zeros(largestClear, ChunkMesher::ChunkVertex{ 0, 0 });
+    for (const SliceWrite& clear : clears) {
+        mVBO.BufferSubData(zeros.data(), clear.offset * sizeof(ChunkMesher::ChunkVertex), clear.size * sizeof(ChunkMesher::ChunkVertex));
+    }
+
+    // Neighbouring layers of a face are usually next to each other in the buffer, so merge their writes
+    for (std::size_t i = 0; i < writes.size();) {
+        SliceWrite write = writes[i++];
+        while (i < writes.size() && writes[i].offset == write.offset + write.size && writes[i].stagingOffset == write.stagingOffset + write.size) {
+            write.size += writes[i++].size;
+        }
+        mVBO.BufferSubData(&sStaging[write.stagingOffset], write.offset * sizeof(ChunkMesher::ChunkVertex), write.size * sizeof(ChunkMesher::ChunkVertex));
+    }
+
+    mLayout = std::move(layout);
+    UpdateFaceRanges();
+    return true;
+}
+
+std::size_t SlicedVertexBuffer::GetVertexCount() const
+{
+    return mLayout.end;
+}
+
+void SlicedVertexBuffer::UpdateFaceRanges()
+{
+    for (int face = 0; face < 6; face++) {
+        mFaceSpareRanges[face].clear();
+        mFaceVertexCounts[face] = 0;
+        for (int layer = 0; layer < ChunkMesher::SLICE_LAYERS; layer++) {
+            const Slot& slot = mLayout.slots[(face * ChunkMesher::SLICE_LAYERS) + layer];
+            mFaceVertexCounts[face] += slot.size;
+            if (slot.offset >= mSpareOffset && slot.size > 0) {
+                mFaceSpareRanges[face].push_back(Range{ slot.offset, slot.size });
+            }
+        }
+    }
+}
+
+void SlicedVertexBuffer::GetFaceRanges(uint8_t faces, std::vector<Range>& ranges) const
+{
+    ranges.clear();
+    for (int face = 0; face < 6; face++) {
+        if (!(faces & (1 << face))) continue;
+        if (mFaceRanges[face].size > 0) {
+            ranges.push_back(mFaceRanges[face]);
+        }
+        ranges.insert(ranges.end(), mFaceSpareRanges[face].begin(), mFaceSpareRanges[face].end());
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+    std::size_t joined = 0;
+    for (std::size_t i = 0; i < ranges.size(); i++) {
+        if (joined > 0 && ranges[joined - 1].offset + ranges[joined - 1].size == ranges[i].offset) {
+            ranges[joined - 1].size += ranges[i].size;
+        }
+        else {
+            ranges[joined++] = ranges[i];
+        }
+    }
+    ranges.resize(joined);
+}
+
+uint32_t SlicedVertexBuffer::GetFaceVertexCount(uint8_t faces) const
+{
+    uint32_t count = 0;
+    for (int face = 0; face < 6; face++) {
+        if (faces & (1 << face)) count += mFaceVertexCounts[face];
+    }
+    return count;
+}
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,91 @@
+/*
+Copyright (C) 2023 William Redding - All Rights Reserved
+License: MIT
+*/
+
+#ifndef SLICED_VERTEX_BUFFER_H
+#define SLICED_VERTEX_BUFFER_H
+
+#include <opengl/BufferObject.hpp>
+#include <world/chunk/ChunkMesher.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+Vertex buffer holding one stream of a chunk mesh, grouped by slice. Every slice owns a range of the buffer it
+can shrink back into, so remeshed slices are patched in place with BufferSubData. A slice that outgrows its
+range moves to a free range of its own face or to the spare space left at the end of the buffer. Unused
+vertices inside the drawn part of the buffer are zeroed, which makes them degenerate quads.
+
+A full upload lays the faces out one after another, so each face can be drawn on its own from its range and
+any of its slices that moved into the spare space.
+*/
+class SlicedVertexBuffer {
+public:
+    struct Range {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+private:
+    struct Slot {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t capacity = 0;
+    };
+    struct Layout {
+        std::array<Slot, ChunkMesher::NUM_SLICES> slots{};
+        std::vector<Range> freeRanges;
+        uint32_t end = 0; // Everything before this is drawn
+    };
+    VertexBuffer mVBO;
+    Layout mLayout;
+    uint32_t mCapacity = 0; // In vertices
+    std::array<Range, 6> mFaceRanges{}; // Where the full upload put each face, the spare space starts after them
+    uint32_t mSpareOffset = 0;
+    std::array<std::vector<Range>, 6> mFaceSpareRanges; // Slices of each face that moved into the spare space
+    std::array<uint32_t, 6> mFaceVertexCounts{};
+    void UpdateFaceRanges();
+    bool AllocateSlot(Layout& layout, int face, uint32_t size, Slot& slot) const;
+    bool PlaceSlices(const ChunkMesher::MeshStream& stream, const ChunkMesher::SliceMask& slices, Layout& layout) const;
+public:
+    const VertexBuffer& GetBuffer() const;
+    // Replace the whole buffer, leaving spare space at the end for slices to grow into
+    void Upload(const ChunkMesher::MeshStream& stream);
+    // Whether the given slices of a partial mesh fit in the buffer without reuploading it
+    bool CanUploadSlices(const ChunkMesher::MeshStream& stream, const ChunkMesher::SliceMask& slices) const;
+    // Replace only the given slices with those of a partial mesh, returns false and changes nothing if they don't fit
+    bool UploadSlices(const ChunkMesher::MeshStream& stream, const ChunkMesher::SliceMask& slices);
+    // Vertices to draw, including any degenerate padding
+    std::size_t GetVertexCount() const;
+    // Ranges holding the faces in a mask of faces, sorted with neighbouring ranges joined
+    void GetFaceRanges(uint8_t faces, std::vector<Range>& ranges) const;
+    // Vertices of the faces in a mask of faces, not counting degenerate padding
+    uint32_t GetFaceVertexCount(uint8_t faces) const;
+};
+
+#endif // !SLICED_VERTEX_BUFFER_H
+
+/*
+MIT License
+
+Copyright (c) 2023 William Redding
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -1,4 +1,4 @@
 #! /bin/sh
 
 cd ../../build/
-./MinecraftClone
\ No newline at end of file
+./MinecraftClone "$@"
\ No newline at end of file